@@ -173,11 +173,12 @@ void TrainingDB::updateLBPHFaceModel(LBPHFaceModel& model)
         model.databaseId = insertedId.toInt();
     }
 
-    QList<LBPHistogramMetadata> metadataList = model.histogramMetadata();
+    // Only the histograms added since the last commit need to be written
+    const int count = model.histogramCount();
 
-    for (int i = 0 ; i < metadataList.size() ; i++)
+    for (int i = model.firstUnsavedHistogram() ; i < count ; i++)
     {
-        const LBPHistogramMetadata& metadata = metadataList[i];
+        const LBPHistogramMetadata& metadata = model.histogramMetadata(i);
 
         if (metadata.storageStatus == LBPHistogramMetadata::Created)
         {
@@ -0,0 +1,382 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Precompiled binary cache of old-style OpenCV Haar cascades.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "binaryhaarcascade.h"
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+
+// C++ includes
+
+#include <cstring>
+#include <vector>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Local includes
+
+#include "libkface_debug.h"
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+const quint32 CacheMagic   = 0x4348464b; // "KFHC"
+const quint32 CacheVersion = 2;
+
+/**
+ * The file starts with the header, followed by the payload:
+ * - stageCount StageRecords
+ * - classifierCount qint32: the number of nodes of each classifier
+ * - nodeCount CvHaarFeature, then nodeCount floats (threshold) and
+ *   2 x nodeCount ints (left, right)
+ * - alphaCount floats: count + 1 values for each classifier
+ * All data is in the native layout of the machine that wrote it.
+ */
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 featureSize;
+    quint32 stageRecordSize;
+    qint64  xmlSize;
+    qint64  xmlModified;
+    qint32  flags;
+    qint32  stageCount;
+    qint32  windowWidth;
+    qint32  windowHeight;
+    qint32  classifierCount;
+    qint32  nodeCount;
+    qint32  alphaCount;
+    qint32  reserved;
+};
+
+struct StageRecord
+{
+    qint32 count;
+    float  threshold;
+    qint32 next;
+    qint32 child;
+    qint32 parent;
+    qint32 reserved;
+};
+
+qint64 payloadSize(const CacheHeader& header)
+{
+    return qint64(header.stageCount)      * sizeof(StageRecord)     +
+           qint64(header.classifierCount) * sizeof(qint32)          +
+           qint64(header.nodeCount)       * (sizeof(CvHaarFeature) + sizeof(float) + 2 * sizeof(int)) +
+           qint64(header.alphaCount)      * sizeof(float);
+}
+
+/// The cache file in the user's cache directory. Derived files never go to the data directory of the XML file.
+QString cacheFile(const QString& xmlFile)
+{
+    const QFileInfo info(xmlFile);
+    const QString   pathHash = QString::fromLatin1(QCryptographicHash::hash(info.absoluteFilePath().toUtf8(),
+                                                                             QCryptographicHash::Md5).toHex().left(8));
+
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+           QString::fromLatin1("/libkface/haarcascades/") +
+           info.fileName() + QString::fromLatin1("-") + pathHash + QString::fromLatin1(".cache");
+}
+
+template <typename T>
+void appendData(QByteArray& data, const T* const values, int count)
+{
+    data.append(reinterpret_cast<const char*>(values), count * (int)sizeof(T));
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------------
+
+class BinaryHaarCascade::Private
+{
+public:
+
+    Private()
+    {
+        memset(&cascade, 0, sizeof(cascade));
+    }
+
+    bool setup(const uchar* const data, qint64 size, const QFileInfo& xml);
+
+public:
+
+    QFile                              file;
+    CvHaarClassifierCascade            cascade;
+    std::vector<CvHaarStageClassifier> stages;
+    std::vector<CvHaarClassifier>      classifiers;
+};
+
+bool BinaryHaarCascade::Private::setup(const uchar* const data, qint64 size, const QFileInfo& xml)
+{
+    if (size < (qint64)sizeof(CacheHeader))
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic           != CacheMagic                                ||
+        header.version         != CacheVersion                              ||
+        header.featureSize     != sizeof(CvHaarFeature)                     ||
+        header.stageRecordSize != sizeof(StageRecord)                       ||
+        header.xmlSize         != xml.size()                                ||
+        header.xmlModified     != xml.lastModified().toMSecsSinceEpoch()    ||
+        header.stageCount      <= 0 || header.classifierCount <= 0          ||
+        header.nodeCount       <= 0 || header.alphaCount      <= 0          ||
+        payloadSize(header)    != size - (qint64)sizeof(header))
+    {
+        return false;
+    }
+
+    // No checksum over the payload: reading all of it would defeat the lazy mapping.
+    // The key above and the consistency of the counts below detect outdated and truncated files.
+    const char* const payload = reinterpret_cast<const char*>(data + sizeof(header));
+
+    const StageRecord* const   stageRecords    = reinterpret_cast<const StageRecord*>(payload);
+    const qint32* const        classifierNodes = reinterpret_cast<const qint32*>(stageRecords + header.stageCount);
+    CvHaarFeature* const       features        = const_cast<CvHaarFeature*>(reinterpret_cast<const CvHaarFeature*>(classifierNodes + header.classifierCount));
+    float* const               thresholds      = reinterpret_cast<float*>(features + header.nodeCount);
+    int* const                 left            = reinterpret_cast<int*>(thresholds + header.nodeCount);
+    int* const                 right           = left + header.nodeCount;
+    float* const               alphas          = reinterpret_cast<float*>(right + header.nodeCount);
+
+    // The mapping is read-only: OpenCV only reads the stage classifiers,
+    // and copies the features to its own evaluation structure.
+    stages.resize(header.stageCount);
+    classifiers.resize(header.classifierCount);
+
+    int classifier = 0;
+    int node       = 0;
+    int alpha      = 0;
+
+    for (int i = 0 ; i < header.stageCount ; ++i)
+    {
+        const StageRecord& record = stageRecords[i];
+
+        if (record.count <= 0 || record.count > header.classifierCount - classifier)
+        {
+            return false;
+        }
+
+        CvHaarStageClassifier& stage = stages[i];
+        stage.count                  = record.count;
+        stage.threshold              = record.threshold;
+        stage.next                   = record.next;
+        stage.child                  = record.child;
+        stage.parent                 = record.parent;
+        stage.classifier             = &classifiers[classifier];
+
+        for (int j = 0 ; j < record.count ; ++j, ++classifier)
+        {
+            const int count = classifierNodes[classifier];
+
+            if (count <= 0 || count > header.nodeCount - node || count + 1 > header.alphaCount - alpha)
+            {
+                return false;
+            }
+
+            CvHaarClassifier& c = classifiers[classifier];
+            c.count             = count;
+            c.haar_feature      = features   + node;
+            c.threshold         = thresholds + node;
+            c.left              = left       + node;
+            c.right             = right      + node;
+            c.alpha             = alphas     + alpha;
+
+            node               += count;
+            alpha              += count + 1;
+        }
+    }
+
+    if (classifier != header.classifierCount || node != header.nodeCount || alpha != header.alphaCount)
+    {
+        return false;
+    }
+
+    memset(&cascade, 0, sizeof(cascade));
+    cascade.flags            = header.flags;
+    cascade.count            = header.stageCount;
+    cascade.orig_window_size = cvSize(header.windowWidth, header.windowHeight);
+    cascade.stage_classifier = &stages[0];
+    cascade.hid_cascade      = 0;
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------
+
+BinaryHaarCascade::BinaryHaarCascade()
+    : d(new Private)
+{
+}
+
+BinaryHaarCascade::~BinaryHaarCascade()
+{
+    delete d;
+}
+
+const CvHaarClassifierCascade& BinaryHaarCascade::cascade() const
+{
+    return d->cascade;
+}
+
+bool BinaryHaarCascade::load(const QString& xmlFile)
+{
+    const QFileInfo xml(xmlFile);
+    d->file.setFileName(cacheFile(xmlFile));
+
+    if (!d->file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    const qint64 size = d->file.size();
+    uchar* const data = size ? d->file.map(0, size) : 0;
+
+    if (data && d->setup(data, size, xml))
+    {
+        qCDebug(LIBKFACE_LOG) << "Mapped binary cascade " << d->file.fileName();
+        return true;
+    }
+
+    qCDebug(LIBKFACE_LOG) << "Ignoring outdated or invalid binary cascade " << d->file.fileName();
+
+    if (data)
+    {
+        d->file.unmap(data);
+    }
+
+    d->file.close();
+
+    return false;
+}
+
+bool BinaryHaarCascade::save(const QString& xmlFile, const CvHaarClassifierCascade& cascade)
+{
+    const QFileInfo xml(xmlFile);
+
+    if (!xml.exists() || cascade.count <= 0 || !cascade.stage_classifier)
+    {
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic           = CacheMagic;
+    header.version         = CacheVersion;
+    header.featureSize     = sizeof(CvHaarFeature);
+    header.stageRecordSize = sizeof(StageRecord);
+    header.xmlSize         = xml.size();
+    header.xmlModified     = xml.lastModified().toMSecsSinceEpoch();
+    header.flags           = cascade.flags;
+    header.stageCount      = cascade.count;
+    header.windowWidth     = cascade.orig_window_size.width;
+    header.windowHeight    = cascade.orig_window_size.height;
+
+    std::vector<StageRecord> stageRecords(cascade.count);
+    std::vector<qint32>      classifierNodes;
+
+    for (int i = 0 ; i < cascade.count ; ++i)
+    {
+        const CvHaarStageClassifier& stage = cascade.stage_classifier[i];
+        StageRecord& record                = stageRecords[i];
+        memset(&record, 0, sizeof(record));
+        record.count                       = stage.count;
+        record.threshold                   = stage.threshold;
+        record.next                        = stage.next;
+        record.child                       = stage.child;
+        record.parent                      = stage.parent;
+
+        for (int j = 0 ; j < stage.count ; ++j)
+        {
+            classifierNodes.push_back(stage.classifier[j].count);
+            header.nodeCount  += stage.classifier[j].count;
+            header.alphaCount += stage.classifier[j].count + 1;
+        }
+    }
+
+    header.classifierCount = (qint32)classifierNodes.size();
+
+    // Arrays of the same kind are stored one after another
+    QByteArray features, thresholds, left, right, alphas;
+
+    for (int i = 0 ; i < cascade.count ; ++i)
+    {
+        const CvHaarStageClassifier& stage = cascade.stage_classifier[i];
+
+        for (int j = 0 ; j < stage.count ; ++j)
+        {
+            const CvHaarClassifier& c = stage.classifier[j];
+            appendData(features,   c.haar_feature, c.count);
+            appendData(thresholds, c.threshold,    c.count);
+            appendData(left,       c.left,         c.count);
+            appendData(right,      c.right,        c.count);
+            appendData(alphas,     c.alpha,        c.count + 1);
+        }
+    }
+
+    QByteArray payload;
+    payload.reserve(payloadSize(header));
+    appendData(payload, &stageRecords[0],    (int)stageRecords.size());
+    appendData(payload, &classifierNodes[0], (int)classifierNodes.size());
+    payload.append(features).append(thresholds).append(left).append(right).append(alphas);
+
+    const QString path = cacheFile(xmlFile);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+
+    if (file.open(QIODevice::WriteOnly)                                                              &&
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == (qint64)sizeof(header) &&
+        file.write(payload) == payload.size()                                                        &&
+        file.commit())
+    {
+        qCDebug(LIBKFACE_LOG) << "Wrote binary cascade " << path;
+        return true;
+    }
+
+    qCDebug(LIBKFACE_LOG) << "Cannot write a binary cache for cascade " << xmlFile;
+    return false;
+}
+
+} // namespace KFaceIface
+
+#endif // OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
@@ -0,0 +1,90 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Precompiled binary cache of old-style OpenCV Haar cascades.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_BINARYHAARCASCADE_H
+#define KFACE_BINARYHAARCASCADE_H
+
+// OpenCV library
+
+#include "libopencv.h"
+
+// Qt includes
+
+#include <QString>
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+
+namespace KFaceIface
+{
+
+/**
+ * Parsing the XML of a Haar cascade takes much longer than the detection in a typical image.
+ * The parsed cascade is therefore written to a binary cache file in the user's cache directory,
+ * never next to the installed XML file. Later, the cache file is mapped into memory and the
+ * cascade is set up directly on the mapped data.
+ *
+ * A cache file is only used if it was written for the same XML file size and modification time,
+ * by a build with the same structure layout, and if its size and counts are consistent.
+ * The content itself is not read at load time, to keep the mapping lazy.
+ */
+class BinaryHaarCascade
+{
+public:
+
+    BinaryHaarCascade();
+    ~BinaryHaarCascade();
+
+    /**
+     * Maps the cache file of xmlFile. Returns false if there is none, or if it is outdated or invalid.
+     */
+    bool load(const QString& xmlFile);
+
+    /**
+     * The cascade set up on the mapped data, valid after load() succeeded, as long as this object lives.
+     * The stage classifiers are owned by this object: use the cascade as a template for
+     * copies of the CvHaarClassifierCascade structure, never release it.
+     */
+    const CvHaarClassifierCascade& cascade() const;
+
+    /**
+     * Writes the cache file of xmlFile for cascade, loaded from this file.
+     */
+    static bool save(const QString& xmlFile, const CvHaarClassifierCascade& cascade);
+
+private:
+
+    class Private;
+    Private* const d;
+
+    BinaryHaarCascade(const BinaryHaarCascade&);
+    BinaryHaarCascade& operator=(const BinaryHaarCascade&);
+};
+
+} // namespace KFaceIface
+
+#endif // OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+
+#endif // KFACE_BINARYHAARCASCADE_H
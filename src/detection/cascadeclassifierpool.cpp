@@ -0,0 +1,580 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Thread-safe access to a loaded OpenCV cascade classifier.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "cascadeclassifierpool.h"
+
+// Qt includes
+
+#include <QFileInfo>
+#include <QGlobalStatic>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWeakPointer>
+
+// Local includes
+
+#include "libkface_debug.h"
+#include "binaryhaarcascade.h"
+#include "detectioncontext.h"
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+/**
+ * The process-wide registry of loaded cascades, keyed by canonical file path.
+ * Entries expire when the last user releases the pool.
+ */
+class CascadeRegistry
+{
+public:
+
+    QMutex                                               mutex;
+    QHash<QString, QWeakPointer<CascadeClassifierPool> > pools;
+};
+
+Q_GLOBAL_STATIC(CascadeRegistry, cascadeRegistry)
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+
+/**
+ * Evaluates a Haar cascade, set to the integral images and scale, at the window positions
+ * of one scale in a region of the image, one row of windows per loop index.
+ * Steps through the windows like cvHaarDetectObjects() does. The windows found
+ * in a row go to the vector of that row, which keeps the order independent of the threads.
+ */
+class HaarWindowScan : public cv::ParallelLoopBody
+{
+public:
+
+    HaarWindowScan(const CvHaarClassifierCascade* const cascade, const cv::Rect& roi, const cv::Size& windowSize,
+                   int endX, double step, const cv::Mat& cannySum, const cv::Rect& edgeRect,
+                   std::vector<std::vector<cv::Rect> >* const rows)
+        : m_cascade(cascade),
+          m_roi(roi),
+          m_windowSize(windowSize),
+          m_endX(endX),
+          m_step(step),
+          m_cannySum(cannySum),
+          m_edgeRect(edgeRect),
+          m_rows(rows)
+    {
+    }
+
+    void operator()(const cv::Range& range) const
+    {
+        for (int iy = range.start ; iy < range.end ; ++iy)
+        {
+            const int y = cvRound(iy * m_step);
+            int ixstep  = 1;
+
+            for (int ix = 0 ; ix < m_endX ; ix += ixstep)
+            {
+                const int x = cvRound(ix * m_step);
+
+                if (!m_cannySum.empty())
+                {
+                    // Skip windows with too few edges
+                    const int* const top    = m_cannySum.ptr<int>(y + m_edgeRect.y)                     + x + m_edgeRect.x;
+                    const int* const bottom = m_cannySum.ptr<int>(y + m_edgeRect.y + m_edgeRect.height) + x + m_edgeRect.x;
+
+                    if (top[0] - top[m_edgeRect.width] - bottom[0] + bottom[m_edgeRect.width] < 100)
+                    {
+                        // Keeps the step, as cvHaarDetectObjects() does
+                        continue;
+                    }
+                }
+
+                // Windows leaving the region are not evaluated, as if the integral images covered the region only
+                int result = -1;
+
+                if (x + m_windowSize.width <= m_roi.width && y + m_windowSize.height <= m_roi.height)
+                {
+                    result = cvRunHaarClassifierCascade(m_cascade, cvPoint(m_roi.x + x, m_roi.y + y), 0);
+                }
+
+                if (result > 0)
+                {
+                    (*m_rows)[iy].push_back(cv::Rect(x, y, m_windowSize.width, m_windowSize.height));
+                }
+
+                ixstep = (result != 0) ? 1 : 2;
+            }
+        }
+    }
+
+private:
+
+    const CvHaarClassifierCascade* const       m_cascade;
+    const cv::Rect                             m_roi;
+    const cv::Size                             m_windowSize;
+    const int                                  m_endX;
+    const double                               m_step;
+    const cv::Mat&                             m_cannySum;
+    const cv::Rect                             m_edgeRect;
+    std::vector<std::vector<cv::Rect> >* const m_rows;
+};
+
+bool hasTiltedFeatures(const CvHaarClassifierCascade& cascade)
+{
+    for (int i = 0 ; i < cascade.count ; ++i)
+    {
+        const CvHaarStageClassifier& stage = cascade.stage_classifier[i];
+
+        for (int j = 0 ; j < stage.count ; ++j)
+        {
+            const CvHaarClassifier& classifier = stage.classifier[j];
+
+            for (int k = 0 ; k < classifier.count ; ++k)
+            {
+                if (classifier.haar_feature[k].tilted)
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+#endif
+
+} // namespace
+
+// --------------------------------------------------------------------------------
+
+class CascadeClassifierPool::Instance : public cv::CascadeClassifier
+{
+public:
+
+    Instance()
+        : sharesClassifiers(false)
+    {
+    }
+
+    ~Instance()
+    {
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+        if (sharesClassifiers && !oldCascade.empty())
+        {
+            // The stage classifiers belong to the pool.
+            // cvReleaseHaarClassifierCascade() shall only free our evaluation state.
+            oldCascade->count            = 0;
+            oldCascade->stage_classifier = 0;
+        }
+#endif
+    }
+
+    cv::Size originalWindowSize() const
+    {
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+        // This is a HACK which may break any time. Work around the fact that getOriginalWindowSize()
+        // always returns (0,0) and we need these values.
+        if (!oldCascade.empty())
+        {
+            return oldCascade->orig_window_size;
+        }
+#endif
+        // New-style cascades, like LBP cascades, report their size
+        return getOriginalWindowSize();
+    }
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+
+    /// The old-style cascade with the stage classifiers, or 0 for other cascades
+    const CvHaarClassifierCascade* haarCascade() const
+    {
+        return oldCascade;
+    }
+
+    /**
+     * Makes this instance use the stage classifiers of classifiers,
+     * which must stay alive as long as this instance.
+     */
+    void shareClassifiers(const CvHaarClassifierCascade& classifiers)
+    {
+        // Allocated like by cvLoad(), as it is freed by cvReleaseHaarClassifierCascade()
+        CvHaarClassifierCascade* const cascade = (CvHaarClassifierCascade*)cvAlloc(sizeof(CvHaarClassifierCascade));
+        *cascade                               = classifiers;
+        // created on first use by cvHaarDetectObjects(), and private to this instance
+        cascade->hid_cascade                   = 0;
+        oldCascade                             = cascade;
+        sharesClassifiers                      = true;
+    }
+
+    /**
+     * The scan of cvHaarDetectObjects() without CV_HAAR_SCALE_IMAGE on the region roi
+     * of the image of context, but on the integral images of the context instead of its own.
+     * Only for instances with a haarCascade().
+     */
+    void detectOnIntegrals(const DetectionContext& context, const cv::Rect& roi, std::vector<cv::Rect>& objects,
+                           std::vector<int>& neighbors, double scaleFactor, int minNeighbors, int flags,
+                           const cv::Size& minSize, const cv::Size& maxSize, bool withTilted)
+    {
+        CvHaarClassifierCascade* const cascade = oldCascade;
+        const cv::Size maxWindowSize           = (maxSize.width && maxSize.height) ? maxSize : roi.size();
+        std::vector<cv::Rect> candidates;
+
+        objects.clear();
+
+        cv::Mat sum, sqsum, tilted, cannySum;
+        context.integrals(sum, sqsum, tilted, withTilted);
+
+        if (flags & CV_HAAR_DO_CANNY_PRUNING)
+        {
+            cannySum = context.cannyIntegral(roi);
+        }
+
+        CvMat sumHeader    = sum;
+        CvMat sqsumHeader  = sqsum;
+        CvMat tiltedHeader = withTilted ? CvMat(tilted) : CvMat();
+
+        int factors = 0;
+
+        for (double factor = 1 ;
+             factor * cascade->orig_window_size.width  < roi.width  - 10 &&
+             factor * cascade->orig_window_size.height < roi.height - 10 ;
+             factor *= scaleFactor)
+        {
+            factors++;
+        }
+
+        double factor = 1;
+
+        for ( ; factors-- > 0 ; factor *= scaleFactor)
+        {
+            const double step         = std::max(2., factor);
+            const cv::Size windowSize = cv::Size(cvRound(cascade->orig_window_size.width  * factor),
+                                                 cvRound(cascade->orig_window_size.height * factor));
+            const int endX            = cvRound((roi.width  - windowSize.width)  / step);
+            const int endY            = cvRound((roi.height - windowSize.height) / step);
+
+            if (windowSize.width < minSize.width || windowSize.height < minSize.height)
+            {
+                continue;
+            }
+
+            if (windowSize.width > maxWindowSize.width || windowSize.height > maxWindowSize.height)
+            {
+                break;
+            }
+
+            cvSetImagesForHaarClassifierCascade(cascade, &sumHeader, &sqsumHeader, withTilted ? &tiltedHeader : 0, factor);
+
+            const cv::Rect edgeRect = cv::Rect(cvRound(windowSize.width  * 0.15), cvRound(windowSize.height * 0.15),
+                                               cvRound(windowSize.width  * 0.7),  cvRound(windowSize.height * 0.7));
+
+            std::vector<std::vector<cv::Rect> > rows(std::max(endY, 0));
+
+            cv::parallel_for_(cv::Range(0, endY),
+                              HaarWindowScan(cascade, roi, windowSize, endX, step, cannySum, edgeRect, &rows));
+
+            // In row order, as the grouping depends on the order of the candidates
+            for (size_t iy = 0 ; iy < rows.size() ; ++iy)
+            {
+                candidates.insert(candidates.end(), rows[iy].begin(), rows[iy].end());
+            }
+        }
+
+        groupCandidates(candidates, minNeighbors, objects, neighbors);
+    }
+
+#endif
+
+    /**
+     * Same as detectMultiScale(), also returning the number of raw detections grouped into each object.
+     */
+    void detectGrouped(const cv::Mat& image, std::vector<cv::Rect>& objects, std::vector<int>& neighbors,
+                       double scaleFactor, int minNeighbors, int flags, const cv::Size& minSize, const cv::Size& maxSize)
+    {
+        // Without grouping, and then grouped the way detectMultiScale() does it
+        std::vector<cv::Rect> candidates;
+        detectMultiScale(image, candidates, scaleFactor, 0, flags, minSize, maxSize);
+        groupCandidates(candidates, minNeighbors, objects, neighbors);
+    }
+
+    /**
+     * Groups candidate windows, as cv::CascadeClassifier does, dropping groups of up to minNeighbors windows.
+     */
+    static void groupCandidates(std::vector<cv::Rect>& candidates, int minNeighbors,
+                                std::vector<cv::Rect>& objects, std::vector<int>& neighbors)
+    {
+        if (minNeighbors != 0)
+        {
+            cv::groupRectangles(candidates, neighbors, std::max(minNeighbors, 1), 0.2);
+        }
+        else
+        {
+            neighbors.assign(candidates.size(), 1);
+        }
+
+        objects = candidates;
+    }
+
+private:
+
+    bool sharesClassifiers;
+};
+
+// --------------------------------------------------------------------------------
+
+class CascadeClassifierPool::Private
+{
+public:
+
+    Private()
+        : empty(true),
+          prototype(0)
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+        , binary(0),
+          sharedClassifiers(0),
+          tiltedFeatures(false)
+#endif
+    {
+    }
+
+public:
+
+    QString                        file;
+    cv::Size                       originalWindowSize;
+    bool                           empty;
+
+    /// Owner of the stage classifiers if they were loaded from XML, never used for detection
+    Instance*                      prototype;
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    /// Owner of the stage classifiers if they were mapped from the binary cache
+    BinaryHaarCascade*             binary;
+
+    /// The old-style cascade all instances share, if any
+    const CvHaarClassifierCascade* sharedClassifiers;
+#endif
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    /// If the integral images of the rotated image are needed
+    bool                           tiltedFeatures;
+#endif
+
+    QMutex                         mutex;
+    QList<Instance*>               idle;
+};
+
+CascadeClassifierPool::CascadeClassifierPool(const QString& file)
+    : d(new Private)
+{
+    d->file = file;
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    d->binary = new BinaryHaarCascade;
+
+    if (!file.isEmpty() && d->binary->load(file))
+    {
+        d->sharedClassifiers  = &d->binary->cascade();
+        d->empty              = false;
+        d->originalWindowSize = d->sharedClassifiers->orig_window_size;
+        d->tiltedFeatures     = hasTiltedFeatures(*d->sharedClassifiers);
+        return;
+    }
+
+    delete d->binary;
+    d->binary = 0;
+#endif
+
+    Instance* const instance = new Instance;
+
+    if (file.isEmpty() || !instance->load(file.toStdString()))
+    {
+        qCDebug(LIBKFACE_LOG) << "Failed to load cascade " << file;
+    }
+
+    d->empty              = instance->empty();
+    d->originalWindowSize = instance->originalWindowSize();
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    if (instance->haarCascade())
+    {
+        d->prototype         = instance;
+        d->sharedClassifiers = instance->haarCascade();
+        d->tiltedFeatures    = hasTiltedFeatures(*d->sharedClassifiers);
+        BinaryHaarCascade::save(file, *d->sharedClassifiers);
+        return;
+    }
+#endif
+
+    d->idle << instance;
+}
+
+CascadeClassifierPool::~CascadeClassifierPool()
+{
+    // Instances sharing the stage classifiers go first
+    qDeleteAll(d->idle);
+    delete d->prototype;
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    delete d->binary;
+#endif
+    delete d;
+}
+
+QSharedPointer<CascadeClassifierPool> CascadeClassifierPool::forFile(const QString& file)
+{
+    const QString canonicalFile = QFileInfo(file).canonicalFilePath();
+    const QString key           = canonicalFile.isEmpty() ? file : canonicalFile;
+    CascadeRegistry* const reg  = cascadeRegistry();
+    QMutexLocker lock(&reg->mutex);
+
+    QSharedPointer<CascadeClassifierPool> pool = reg->pools.value(key).toStrongRef();
+
+    if (!pool)
+    {
+        pool = QSharedPointer<CascadeClassifierPool>(new CascadeClassifierPool(key));
+        reg->pools.insert(key, pool);
+    }
+
+    return pool;
+}
+
+QString CascadeClassifierPool::file() const
+{
+    return d->file;
+}
+
+bool CascadeClassifierPool::empty() const
+{
+    return d->empty;
+}
+
+cv::Size CascadeClassifierPool::originalWindowSize() const
+{
+    return d->originalWindowSize;
+}
+
+CascadeClassifierPool::Instance* CascadeClassifierPool::acquire() const
+{
+    {
+        QMutexLocker lock(&d->mutex);
+
+        if (!d->idle.isEmpty())
+        {
+            return d->idle.takeLast();
+        }
+    }
+
+    // All instances are in use: add one for this thread
+    Instance* const instance = new Instance;
+
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+    if (d->sharedClassifiers)
+    {
+        instance->shareClassifiers(*d->sharedClassifiers);
+        return instance;
+    }
+#endif
+
+    instance->load(d->file.toStdString());
+    return instance;
+}
+
+void CascadeClassifierPool::release(Instance* const instance) const
+{
+    QMutexLocker lock(&d->mutex);
+    d->idle << instance;
+}
+
+void CascadeClassifierPool::detectMultiScale(const cv::Mat& image, std::vector<cv::Rect>& objects,
+                                             double scaleFactor, int minNeighbors, int flags, const cv::Size& minSize,
+                                             const cv::Size& maxSize) const
+{
+    if (d->empty)
+    {
+        objects.clear();
+        return;
+    }
+
+    Instance* const instance = acquire();
+
+    try
+    {
+        instance->detectMultiScale(image, objects, scaleFactor, minNeighbors, flags, minSize, maxSize);
+    }
+    catch (...)
+    {
+        release(instance);
+        throw;
+    }
+
+    release(instance);
+}
+
+void CascadeClassifierPool::detectMultiScale(const DetectionContext& context, const cv::Rect& roi,
+                                             std::vector<cv::Rect>& objects, std::vector<int>& neighbors,
+                                             double scaleFactor, int minNeighbors, int flags, const cv::Size& minSize,
+                                             const cv::Size& maxSize) const
+{
+    if (d->empty)
+    {
+        objects.clear();
+        neighbors.clear();
+        return;
+    }
+
+    Instance* const instance = acquire();
+
+    try
+    {
+#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
+        if (instance->haarCascade())
+        {
+            instance->detectOnIntegrals(context, roi, objects, neighbors, scaleFactor, minNeighbors, flags,
+                                        minSize, maxSize, d->tiltedFeatures);
+        }
+        else
+#endif
+        {
+            instance->detectGrouped(context.image()(roi), objects, neighbors, scaleFactor, minNeighbors, flags, minSize, maxSize);
+        }
+    }
+    catch (...)
+    {
+        release(instance);
+        throw;
+    }
+
+    release(instance);
+}
+
+void CascadeClassifierPool::groupWindows(const std::vector<cv::Rect>& windows, int minNeighbors,
+                                         std::vector<cv::Rect>& objects, std::vector<int>& neighbors)
+{
+    std::vector<cv::Rect> candidates = windows;
+    Instance::groupCandidates(candidates, minNeighbors, objects, neighbors);
+}
+
+} // namespace KFaceIface
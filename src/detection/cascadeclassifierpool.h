@@ -0,0 +1,121 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Thread-safe access to a loaded OpenCV cascade classifier.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_CASCADECLASSIFIERPOOL_H
+#define KFACE_CASCADECLASSIFIERPOOL_H
+
+// OpenCV library
+
+#include "libopencv.h"
+
+// Qt includes
+
+#include <QSharedPointer>
+#include <QString>
+
+// C++ includes
+
+#include <vector>
+
+namespace KFaceIface
+{
+
+class DetectionContext;
+
+/**
+ * A cascade classifier loaded once from file, which can be used from many threads at the same time.
+ *
+ * cv::CascadeClassifier keeps the evaluation state of the last image in the classifier,
+ * so one object cannot run two detections concurrently. The pool hands out one
+ * classifier instance per concurrent detection and keeps it for reuse afterwards.
+ *
+ * With OpenCV 2.4 and the old-style Haar cascades shipped with libkface, all instances
+ * share the stage classifiers loaded from the file; each instance only adds its own
+ * evaluation state. These cascades are loaded from a binary cache, see BinaryHaarCascade.
+ * With other cascades, each instance is loaded from the file.
+ */
+class CascadeClassifierPool
+{
+public:
+
+    /**
+     * Returns the pool of the cascade in file, shared by all users in the process.
+     * The cascade is loaded on first request, and unloaded when the last reference is released.
+     */
+    static QSharedPointer<CascadeClassifierPool> forFile(const QString& file);
+
+    /// Loads a cascade for this object only. Prefer forFile().
+    explicit CascadeClassifierPool(const QString& file);
+    ~CascadeClassifierPool();
+
+    QString  file()               const;
+    bool     empty()              const;
+
+    /// The size on which the cascade was trained, as read from the XML file, or (0,0)
+    cv::Size originalWindowSize() const;
+
+    /**
+     * Same as cv::CascadeClassifier::detectMultiScale. Thread-safe.
+     */
+    void detectMultiScale(const cv::Mat& image, std::vector<cv::Rect>& objects,
+                          double scaleFactor, int minNeighbors, int flags, const cv::Size& minSize,
+                          const cv::Size& maxSize = cv::Size()) const;
+
+    /**
+     * Same as above on the region roi of the image of context, returning rectangles relative to roi,
+     * and for each, the number of raw detections grouped into it as confidence.
+     * Old-style Haar cascades evaluate directly on the integral images of the context,
+     * which are computed once for all cascades and regions. Thread-safe.
+     */
+    void detectMultiScale(const DetectionContext& context, const cv::Rect& roi,
+                          std::vector<cv::Rect>& objects, std::vector<int>& neighbors,
+                          double scaleFactor, int minNeighbors, int flags, const cv::Size& minSize,
+                          const cv::Size& maxSize = cv::Size()) const;
+
+    /**
+     * Groups the raw windows found by detectMultiScale() with minNeighbors 0
+     * as it does for minNeighbors, returning the same objects and neighbors.
+     * Windows dropped before, like by a minimum size, give the result of the scan without them.
+     */
+    static void groupWindows(const std::vector<cv::Rect>& windows, int minNeighbors,
+                             std::vector<cv::Rect>& objects, std::vector<int>& neighbors);
+
+private:
+
+    class Instance;
+    class Private;
+    Private* const d;
+
+    Instance* acquire() const;
+    void      release(Instance* const instance) const;
+
+    CascadeClassifierPool(const CascadeClassifierPool&);
+    CascadeClassifierPool& operator=(const CascadeClassifierPool&);
+};
+
+} // namespace KFaceIface
+
+#endif // KFACE_CASCADECLASSIFIERPOOL_H
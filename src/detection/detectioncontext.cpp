@@ -0,0 +1,120 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  The per-image data shared by all cascades of one detection.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "detectioncontext.h"
+
+// Qt includes
+
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace KFaceIface
+{
+
+class DetectionContext::Private
+{
+public:
+
+    cv::Mat image;
+
+    QMutex  mutex;
+    cv::Mat sum;
+    cv::Mat sqsum;
+    cv::Mat tilted;
+    cv::Mat cannySum;
+};
+
+DetectionContext::DetectionContext(const cv::Mat& image)
+    : d(new Private)
+{
+    d->image = image;
+}
+
+DetectionContext::~DetectionContext()
+{
+    delete d;
+}
+
+const cv::Mat& DetectionContext::image() const
+{
+    return d->image;
+}
+
+void DetectionContext::integrals(cv::Mat& sum, cv::Mat& sqsum, cv::Mat& tilted, bool withTilted) const
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (withTilted && d->tilted.empty())
+    {
+        // Other threads may already scan on the shared sum and sqsum: never write into them again
+        cv::Mat newSum, newSqsum;
+        cv::integral(d->image, newSum, newSqsum, d->tilted);
+
+        if (d->sum.empty())
+        {
+            d->sum   = newSum;
+            d->sqsum = newSqsum;
+        }
+    }
+    else if (d->sum.empty())
+    {
+        cv::integral(d->image, d->sum, d->sqsum);
+    }
+
+    sum    = d->sum;
+    sqsum  = d->sqsum;
+    tilted = withTilted ? d->tilted : cv::Mat();
+}
+
+cv::Mat DetectionContext::cannyIntegral(const cv::Rect& roi) const
+{
+    if (roi != cv::Rect(0, 0, d->image.cols, d->image.rows))
+    {
+        // Regions are small and rarely scanned twice: not worth keeping
+        return cannyIntegralOf(d->image(roi));
+    }
+
+    QMutexLocker lock(&d->mutex);
+
+    if (d->cannySum.empty())
+    {
+        d->cannySum = cannyIntegralOf(d->image);
+    }
+
+    return d->cannySum;
+}
+
+cv::Mat DetectionContext::cannyIntegralOf(const cv::Mat& image)
+{
+    // Same thresholds as cvHaarDetectObjects()
+    cv::Mat edges, cannySum;
+    cv::Canny(image, edges, 0, 50, 3);
+    cv::integral(edges, cannySum);
+
+    return cannySum;
+}
+
+} // namespace KFaceIface
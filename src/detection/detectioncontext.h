@@ -0,0 +1,81 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  The per-image data shared by all cascades of one detection.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_DETECTIONCONTEXT_H
+#define KFACE_DETECTIONCONTEXT_H
+
+// OpenCV library
+
+#include "libopencv.h"
+
+namespace KFaceIface
+{
+
+/**
+ * The image of one detection, and the data derived from it which every cascade needs.
+ *
+ * The integral images are computed on first use and then shared by the primary scan
+ * and all verification scans, whatever region of the image they look at.
+ * All methods are thread-safe.
+ */
+class DetectionContext
+{
+public:
+
+    /// image is an 8-bit grayscale image, as prepared for detection. It is not copied.
+    explicit DetectionContext(const cv::Mat& image);
+    ~DetectionContext();
+
+    const cv::Mat& image() const;
+
+    /**
+     * The integral images of image() as by cv::integral(): sum (CV_32S) and squared sum (CV_64F),
+     * and with withTilted, the integral of the image rotated by 45 degrees (CV_32S).
+     * Otherwise, tilted is left empty.
+     */
+    void integrals(cv::Mat& sum, cv::Mat& sqsum, cv::Mat& tilted, bool withTilted) const;
+
+    /**
+     * The integral image of the Canny edges of the region roi of image(), in coordinates relative to roi,
+     * used for CV_HAAR_DO_CANNY_PRUNING. The edges are found in the region only, as when scanning
+     * a copy of the region. Only the one of the whole image is kept and shared.
+     */
+    cv::Mat cannyIntegral(const cv::Rect& roi) const;
+
+private:
+
+    static cv::Mat cannyIntegralOf(const cv::Mat& image);
+
+    DetectionContext(const DetectionContext&);
+    DetectionContext& operator=(const DetectionContext&);
+
+    class Private;
+    Private* const d;
+};
+
+} // namespace KFaceIface
+
+#endif // KFACE_DETECTIONCONTEXT_H
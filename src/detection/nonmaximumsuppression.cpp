@@ -0,0 +1,223 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Non-maximum suppression of overlapping detections.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "nonmaximumsuppression.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <vector>
+
+// Qt includes
+
+#include <QtGlobal>
+
+namespace KFaceIface
+{
+
+double intersectionOverUnion(const QRect& r1, const QRect& r2)
+{
+    const QRect intersection = r1.intersected(r2);
+
+    if (intersection.isEmpty())
+    {
+        return 0;
+    }
+
+    const double intersectionArea = double(intersection.width()) * intersection.height();
+    const double unionArea        = double(r1.width()) * r1.height() + double(r2.width()) * r2.height() - intersectionArea;
+
+    return unionArea > 0 ? intersectionArea / unionArea : 0;
+}
+
+namespace
+{
+
+/**
+ * A uniform grid over the bounding box of all rectangles.
+ * Each cell lists the rectangles covering it, in the order of insertion.
+ */
+class RectGrid
+{
+public:
+
+    RectGrid(const QList<QRect>& rects)
+    {
+        // The typical size: most rectangles then cover up to four cells
+        std::vector<int> sizes;
+        sizes.reserve(rects.size());
+
+        int left   = rects.first().left();
+        int top    = rects.first().top();
+        int right  = rects.first().right();
+        int bottom = rects.first().bottom();
+
+        foreach (const QRect& rect, rects)
+        {
+            sizes.push_back(qMax(rect.width(), rect.height()));
+            left   = qMin(left,   rect.left());
+            top    = qMin(top,    rect.top());
+            right  = qMax(right,  rect.right());
+            bottom = qMax(bottom, rect.bottom());
+        }
+
+        std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+
+        m_cellSize = qMax(1, sizes[sizes.size() / 2]);
+        m_origin   = QPoint(left, top);
+        m_columns  = (right  - left) / m_cellSize + 1;
+        m_rows     = (bottom - top)  / m_cellSize + 1;
+        m_cells.resize(size_t(m_columns) * m_rows);
+    }
+
+    void insert(const QRect& rect, int index)
+    {
+        const QRect range = cellRange(rect);
+
+        for (int y = range.top() ; y <= range.bottom() ; ++y)
+        {
+            for (int x = range.left() ; x <= range.right() ; ++x)
+            {
+                m_cells[size_t(y) * m_columns + x].push_back(index);
+            }
+        }
+    }
+
+    /// The cells covered by rect, as a rectangle of cell coordinates
+    QRect cellRange(const QRect& rect) const
+    {
+        return QRect(QPoint((rect.left()   - m_origin.x()) / m_cellSize, (rect.top()    - m_origin.y()) / m_cellSize),
+                     QPoint((rect.right()  - m_origin.x()) / m_cellSize, (rect.bottom() - m_origin.y()) / m_cellSize));
+    }
+
+    const std::vector<int>& cell(int x, int y) const
+    {
+        return m_cells[size_t(y) * m_columns + x];
+    }
+
+private:
+
+    int                            m_cellSize;
+    QPoint                         m_origin;
+    int                            m_columns;
+    int                            m_rows;
+    std::vector<std::vector<int> > m_cells;
+};
+
+} // namespace
+
+QList<QRect> nonMaximumSuppression(const QList<QRect>& rects, double minOverlap, int minDuplicates,
+                                   QList<int>* const duplicates, QList<int>* const indices)
+{
+    if (duplicates)
+    {
+        duplicates->clear();
+    }
+
+    if (indices)
+    {
+        indices->clear();
+    }
+
+    if (rects.isEmpty())
+    {
+        return QList<QRect>();
+    }
+
+    // Two overlapping rectangles share at least one cell, so each rectangle is only
+    // compared to the rectangles kept before it in the cells it covers.
+    RectGrid grid(rects);
+    std::vector<int> kept;
+    std::vector<int> duplicateCounts;
+
+    for (int i = 0 ; i < rects.size() ; ++i)
+    {
+        const QRect& rect = rects.at(i);
+        const QRect range = grid.cellRange(rect);
+        int original      = -1;
+
+        for (int y = range.top() ; y <= range.bottom() ; ++y)
+        {
+            for (int x = range.left() ; x <= range.right() ; ++x)
+            {
+                const std::vector<int>& cell = grid.cell(x, y);
+
+                // Entries are in the order of priority: the first match is the best of this cell
+                for (std::vector<int>::const_iterator it = cell.begin() ; it != cell.end() ; ++it)
+                {
+                    if (original != -1 && *it >= original)
+                    {
+                        break;
+                    }
+
+                    if (intersectionOverUnion(rects.at(kept[*it]), rect) >= minOverlap)
+                    {
+                        original = *it;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (original != -1)
+        {
+            duplicateCounts[original]++;
+        }
+        else
+        {
+            grid.insert(rect, int(kept.size()));
+            kept.push_back(i);
+            duplicateCounts.push_back(0);
+        }
+    }
+
+    QList<QRect> results;
+
+    for (size_t k = 0 ; k < kept.size() ; ++k)
+    {
+        // Less duplicates, probably not genuine, kick it out
+        if (duplicateCounts[k] < minDuplicates)
+        {
+            continue;
+        }
+
+        results << rects.at(kept[k]);
+
+        if (duplicates)
+        {
+            *duplicates << duplicateCounts[k];
+        }
+
+        if (indices)
+        {
+            *indices << kept[k];
+        }
+    }
+
+    return results;
+}
+
+} // namespace KFaceIface
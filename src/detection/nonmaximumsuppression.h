@@ -0,0 +1,61 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Non-maximum suppression of overlapping detections.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_NONMAXIMUMSUPPRESSION_H
+#define KFACE_NONMAXIMUMSUPPRESSION_H
+
+// Qt includes
+
+#include <QList>
+#include <QRect>
+
+namespace KFaceIface
+{
+
+/**
+ * Returns the area of the intersection of r1 and r2 divided by the area of their union, 0..1.
+ * Unlike a distance in pixels, the value does not depend on the size of the rectangles.
+ */
+double intersectionOverUnion(const QRect& r1, const QRect& r2);
+
+/**
+ * Merges duplicate detections of the same object.
+ *
+ * The rectangles are taken in the order given, which is their priority: a rectangle overlapping
+ * an earlier one by at least minOverlap (intersection over union, 0 < minOverlap <= 1) is a
+ * duplicate of the first such rectangle and is removed. A remaining rectangle with less than
+ * minDuplicates duplicates is removed as well. If duplicates is given, it receives the number
+ * of duplicates of each returned rectangle, and if indices is given, its index in rects.
+ *
+ * Rectangles are only compared to the ones in the same cells of a grid scaled to the typical
+ * rectangle size, so the cost grows with n log n rather than with n squared.
+ */
+QList<QRect> nonMaximumSuppression(const QList<QRect>& rects, double minOverlap, int minDuplicates = 0,
+                                   QList<int>* const duplicates = 0, QList<int>* const indices = 0);
+
+} // namespace KFaceIface
+
+#endif // KFACE_NONMAXIMUMSUPPRESSION_H
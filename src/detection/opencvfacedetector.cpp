@@ -40,14 +40,28 @@
 
 #include "opencvfacedetector.h"
 
+// C++ includes
+
+#include <algorithm>
+#include <utility>
+
 // Qt includes
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSharedPointer>
 #include <QtCore/qmath.h>
 
 // Local includes
 
 #include "libkface_debug.h"
+#include "opencvimageutils.h"
+#include "cascadeclassifierpool.h"
+#include "detectioncontext.h"
+#include "nonmaximumsuppression.h"
 
 using namespace std;
 
@@ -64,6 +78,7 @@ public:
         grouping        = 0;
         flags           = 0;
         minSize         = cv::Size(0,0);
+        maxSize         = cv::Size(0,0);
     }
 
 public:
@@ -72,6 +87,54 @@ public:
     int      grouping;
     int      flags;
     cv::Size minSize;
+    cv::Size maxSize;    // (0,0): unbounded
+};
+
+/**
+ * All parameters of one detection, derived from the tunable values and the image size.
+ * Computed per call, so that one detector can serve concurrent detections.
+ */
+class DetectionParameters
+{
+public:
+
+    DetectionParameters()
+    {
+        minOverlap    = 0;
+        minDuplicates = 0;
+        verify        = true;
+    }
+
+public:
+
+    DetectObjectParameters primaryParams;
+    DetectObjectParameters verifyingParams;
+
+    QList<int>             primaryCascades;    // Indexes of the cascades scanning the image
+    QList<int>             verifyingCascades;  // Indexes of the cascades verifying the faces found
+
+    double                 minOverlap;     // Minimum intersection over union of two faces to call them duplicates
+    int                    minDuplicates;  // Minimum number of duplicates required to qualify as a genuine face
+    bool                   verify;         // If the faces found are verified, false to meet the time budget
+};
+
+/**
+ * One primary cascade run on one region of the image.
+ */
+class PrimaryScan
+{
+public:
+
+    PrimaryScan()
+        : cascade(0)
+    {
+    }
+
+public:
+
+    int                    cascade;
+    cv::Rect               roi;
+    DetectObjectParameters params;
 };
 
 // --------------------------------------------------------------------------------
@@ -93,12 +156,6 @@ static QString findFileInDirs(const QStringList& dirs, const QString& fileName)
     return QString();
 }
 
-static int distanceOfCenters(const QRect& r1, const QRect& r2)
-{
-    QPointF diff = r1.center() - r2.center();
-    return lround(sqrt(diff.x() * diff.x() + diff.y() * diff.y()));    // Euclidean distance
-}
-
 static QRect toQRect(const cv::Rect& rect)
 {
     return QRect(rect.x, rect.y, rect.width, rect.height);
@@ -111,13 +168,16 @@ static cv::Rect fromQRect(const QRect& rect)
 
 // --------------------------------------------------------------------------------
 
-class Cascade : public cv::CascadeClassifier
+/**
+ * A cascade as used by the detector: the loaded classifier, which is immutable and
+ * can be shared by concurrent detections, and its role in the detection.
+ */
+class Cascade
 {
 public:
 
     Cascade(const QStringList& dirs, const QString& fileName)
-        : primaryCascade(false),
-          verifyingCascade(true)
+        : name(fileName)
     {
         const QString file = findFileInDirs(dirs, fileName);
 
@@ -129,24 +189,42 @@ public:
 
         qCDebug(LIBKFACE_LOG) << "Loading cascade " << file;
 
-        if (!load(file.toStdString()))
+        // Loaded only once per process, and shared with all other detectors
+        classifier = CascadeClassifierPool::forFile(file);
+    }
+
+    bool empty() const
+    {
+        return !classifier || classifier->empty();
+    }
+
+    /**
+     * Same as cv::CascadeClassifier::detectMultiScale on the region roi of the image of context.
+     * Thread-safe.
+     */
+    void detectMultiScale(const DetectionContext& context, const cv::Rect& roi,
+                          std::vector<cv::Rect>& objects, std::vector<int>& neighbors,
+                          double scaleFactor, int minNeighbors, int flags,
+                          const cv::Size& minSize, const cv::Size& maxSize) const
+    {
+        if (empty())
         {
-            qCDebug(LIBKFACE_LOG) << "Failed to load cascade " << file;
+            objects.clear();
+            neighbors.clear();
             return;
         }
+
+        classifier->detectMultiScale(context, roi, objects, neighbors, scaleFactor, minNeighbors, flags, minSize, maxSize);
     }
 
     cv::Size getOriginalWindowSize() const
     {
-#if OPENCV_VERSION <= OPENCV_MAKE_VERSION(2,4,99)
-        // This is a HACK which may break any time. Work around the fact that getOriginalWindowSize()
-        // always returns (0,0) and we need these values.
-        if (oldCascade)
+        if (!classifier)
         {
-            return oldCascade->orig_window_size;
+            return cv::Size(0, 0);
         }
-#endif
-        return cv::Size(0, 0);
+
+        return classifier->originalWindowSize();
     }
 
     /**
@@ -157,16 +235,6 @@ public:
     static double faceToFeatureRelationMax()      { return 4;  }
     static double faceToFeatureRelationPresumed() { return 6;  }
 
-    /**
-     * A primary cascade does the initial scan on the whole image area
-     * A verifying cascade scans the area reported by the primary cascade
-     */
-    void setPrimaryCascade(bool isPrimary = true)
-    {
-        primaryCascade   = isPrimary;
-        verifyingCascade = !isPrimary;
-    }
-
     void setROI(double x, double y, double width, double height)
     {
         roi = QRectF(x, y, width, height);
@@ -220,6 +288,44 @@ public:
         return minSize;
     }
 
+    /**
+     * Verifying cascades: Returns the maxSize parameter for cvHaarDetectObjects.
+     * A frontal face found in the extended rect is of the size of the presumed face,
+     * a facial feature is at most faceToFeatureRelationMax of it, with some tolerance.
+     * The scan stops there instead of running up to the size of the searched region.
+     */
+    cv::Size maxSizeForFace(const cv::Size& faceSize) const
+    {
+        cv::Size maxSize;
+
+        if (!isFacialFeature())
+        {
+            maxSize = cv::Size(lround(double(faceSize.width)  * 1.5),
+                               lround(double(faceSize.height) * 1.5));
+        }
+        else
+        {
+            maxSize = cv::Size(lround(double(faceSize.width)  * 2 / faceToFeatureRelationMax()),
+                               lround(double(faceSize.height) * 2 / faceToFeatureRelationMax()));
+        }
+
+        if (lessThanWindowSize(maxSize))
+            return cv::Size(0,0);
+
+        return maxSize;
+    }
+
+    /**
+     * Verifying cascades: Returns the region of the image scanned to verify the face.
+     */
+    cv::Rect verificationRect(const cv::Rect& faceRect, const cv::Rect& extendedRect) const
+    {
+        if (isFacialFeature())
+            return faceROI(faceRect);
+
+        return extendedRect;
+    }
+
     /**
      * For facial features:
      * For the case that a feature ROI is small and shall be scaled up.
@@ -248,14 +354,18 @@ public:
 
 public:
 
-    bool   primaryCascade;
-    bool   verifyingCascade;
+    /// The file name of the cascade, without path
+    QString name;
 
     /**
      * Facial features have a region of interest, e.g., the left eye is typically
      * located in the left upper region of the presumed face.
      * For frontal face cascades, this is 0,0 - 1x1. */
     QRectF roi;
+
+private:
+
+    QSharedPointer<CascadeClassifierPool> classifier;
 };
 
 // ---------------------------------------------------------------------------------------------------
@@ -267,29 +377,261 @@ public:
 
     Private()
     {
-        maxDistance              = 0;
-        minDuplicates            = 0;
         speedVsAccuracy          = 0.8;
         sensitivityVsSpecificity = 0.8;
+        timeBudget               = 0;
+        resetBudget();
+    }
+
+    /// Call with mutex locked
+    void resetBudget()
+    {
+        budgetAccuracy           = speedVsAccuracy;
+        budgetVerification       = true;
+        budgetSamples            = 0;
+        averageMilliseconds      = 0;
+        verificationMilliseconds = 0;
+        budgetSearchIncrement    = 0;
+        budgetMinSize            = 0;
+    }
+
+    /**
+     * Feeds the time taken by a detection of a whole image with params into the time budget control.
+     * After a few detections with the same parameters, the accuracy is lowered while the average time
+     * is above the budget, and raised again up to the accuracy set while it is well below.
+     * Verification is only left out when the budget is missed even at the lowest accuracy.
+     */
+    void adaptToTime(const DetectionParameters& params, double milliseconds, double verifyingMilliseconds)
+    {
+        QMutexLocker lock(&mutex);
+
+        if (timeBudget <= 0)
+        {
+            return;
+        }
+
+        // Exponential moving average of the samples since the last change of parameters
+        averageMilliseconds   = budgetSamples ? 0.7 * averageMilliseconds + 0.3 * milliseconds : milliseconds;
+        budgetSearchIncrement = params.primaryParams.searchIncrement;
+        budgetMinSize         = params.primaryParams.minSize.width;
+
+        if (params.verify)
+        {
+            verificationMilliseconds = budgetSamples ? 0.7 * verificationMilliseconds + 0.3 * verifyingMilliseconds
+                                                     : verifyingMilliseconds;
+        }
+
+        if (++budgetSamples < 3)
+        {
+            return;
+        }
+
+        const double oldAccuracy     = budgetAccuracy;
+        const bool   oldVerification = budgetVerification;
+
+        if (averageMilliseconds > timeBudget)
+        {
+            if (budgetAccuracy > 0)
+            {
+                // Larger steps the farther off the budget
+                budgetAccuracy = qMax(0.0, budgetAccuracy - 0.05 * qMin(4.0, averageMilliseconds / timeBudget));
+            }
+            else
+            {
+                budgetVerification = false;
+            }
+        }
+        else if (averageMilliseconds < 0.7 * timeBudget)
+        {
+            if (!budgetVerification)
+            {
+                if (averageMilliseconds + verificationMilliseconds < 0.9 * timeBudget)
+                {
+                    budgetVerification = true;
+                }
+            }
+            else
+            {
+                budgetAccuracy = qMin(speedVsAccuracy, budgetAccuracy + 0.02);
+            }
+        }
+
+        if (budgetAccuracy != oldAccuracy || budgetVerification != oldVerification)
+        {
+            qCDebug(LIBKFACE_LOG) << "Time budget " << timeBudget << " ms, average " << averageMilliseconds
+                                  << " ms: accuracy " << budgetAccuracy << " verification " << budgetVerification;
+            budgetSamples = 0;
+        }
     }
 
 public:
 
-    QList<Cascade>         cascades;
+    /**
+     * Returns the indexes of the loaded cascades named in names.
+     * Unknown cascades, and cascades which could not be loaded, are left out.
+     */
+    QList<int> cascadeIndexes(const QStringList& names) const
+    {
+        QList<int> indexes;
 
-    int                    maxDistance;    // Maximum distance between two faces to call them unique
-    int                    minDuplicates;  // Minimum number of duplicates required to qualify as a genuine face
+        foreach (const QString& name, names)
+        {
+            int index = -1;
 
-    // Tunable values, for accuracy
-    DetectObjectParameters primaryParams;
-    DetectObjectParameters verifyingParams;
+            for (int i=0; i<cascades.size(); ++i)
+            {
+                if (cascades.at(i).name == name)
+                {
+                    index = i;
+                    break;
+                }
+            }
+
+            if (index == -1)
+            {
+                qCWarning(LIBKFACE_LOG) << "Unknown cascade " << name << ", ignored";
+            }
+            else if (cascades.at(index).empty())
+            {
+                qCWarning(LIBKFACE_LOG) << "Cascade " << name << " is not available, ignored";
+            }
+            else if (!indexes.contains(index))
+            {
+                indexes << index;
+            }
+        }
+
+        return indexes;
+    }
+
+    /// The indexes of the primary and verifying cascades used now
+    void currentCascades(QList<int>& primary, QList<int>& verifying) const
+    {
+        QMutexLocker lock(&mutex);
+        primary = primaryCascades.isEmpty() ? defaultPrimaryCascades : primaryCascades;
+
+        if (verifyingCascades.isEmpty())
+        {
+            // By default, a face is not verified by the cascade which found it
+            verifying = defaultVerifyingCascades;
+
+            foreach (int i, primary)
+            {
+                verifying.removeAll(i);
+            }
+        }
+        else
+        {
+            verifying = verifyingCascades;
+        }
+    }
 
+public:
+
+    // Set up in the constructor, read-only afterwards
+    QList<Cascade>         cascades;
+    QList<int>             defaultPrimaryCascades;
+    QList<int>             defaultVerifyingCascades;
+
+    // Tunable values, for accuracy
+    mutable QMutex         mutex;
     double                 speedVsAccuracy;
     double                 sensitivityVsSpecificity;
+
+    // The cascades chosen with setPrimaryCascades() and setVerifyingCascades(); empty for the defaults
+    QList<int>             primaryCascades;
+    QList<int>             verifyingCascades;
+
+    // Time budget per image in ms, 0 if not used, and the values chosen to meet it
+    double                 timeBudget;
+    double                 budgetAccuracy;
+    bool                   budgetVerification;
+    int                    budgetSamples;
+    double                 averageMilliseconds;
+    double                 verificationMilliseconds;
+    double                 budgetSearchIncrement;
+    int                    budgetMinSize;
+
+public:
+
+    /**
+     * Measured work per cascade, indexed like cascades.
+     * Orders the verifying cascades by cost, and shows what the early exit saves.
+     */
+    class CascadeStatistics
+    {
+    public:
+
+        CascadeStatistics()
+            : runs(0),
+              skipped(0),
+              nanoseconds(0),
+              pixels(0)
+        {
+        }
+
+    public:
+
+        qint64 runs;
+        qint64 skipped;
+        qint64 nanoseconds;
+        qint64 pixels;
+    };
+
+    void addRun(int cascade, qint64 nanoseconds, qint64 pixels)
+    {
+        QMutexLocker lock(&statisticsMutex);
+        CascadeStatistics& stats = statistics[cascade];
+        stats.runs++;
+        stats.nanoseconds += nanoseconds;
+        stats.pixels      += pixels;
+    }
+
+    void addSkipped(int cascade)
+    {
+        QMutexLocker lock(&statisticsMutex);
+        statistics[cascade].skipped++;
+    }
+
+    /// Average time per scanned pixel; 0 as long as the cascade did not run
+    double costPerPixel(int cascade) const
+    {
+        QMutexLocker lock(&statisticsMutex);
+        const CascadeStatistics& stats = statistics.at(cascade);
+        return stats.pixels ? double(stats.nanoseconds) / stats.pixels : 0;
+    }
+
+public:
+
+    mutable QMutex            statisticsMutex;
+    QList<CascadeStatistics>  statistics;
 };
 
 // --------------------------------------------------------------------------------
 
+/**
+ * The voting rule of the face verification.
+ * More votes never turn a verified face into a rejected one, so the outcome is decided as soon as
+ * either the votes given are verifying, or even all remaining votes could not make them verifying.
+ */
+static bool isVerifiedByVotes(int frontalFaceVotes, int facialFeatureVotes, int faceWidth)
+{
+    // Heuristic: Discard a sufficiently large face that shows no facial features
+    if (faceWidth <= 50 && facialFeatureVotes == 0)
+        return false;
+
+    if (frontalFaceVotes && facialFeatureVotes)
+        return true;
+    else if (frontalFaceVotes >= 2)
+        return true;
+    else if (facialFeatureVotes >= 2)
+        return true;
+
+    return false;
+}
+
+// --------------------------------------------------------------------------------
+
 OpenCVFaceDetector::OpenCVFaceDetector(const QStringList& cascadeDirs)
     : d(new Private)
 {
@@ -311,12 +653,26 @@ OpenCVFaceDetector::OpenCVFaceDetector(const QStringList& cascadeDirs)
     d->cascades << Cascade(cascadeDirs, QString::fromLatin1("haarcascade_mcs_nose.xml"));
     d->cascades << Cascade(cascadeDirs, QString::fromLatin1("haarcascade_mcs_mouth.xml"));
 
-    d->cascades[2].setPrimaryCascade();
+    // Integer features, several times faster than the Haar cascades. Installed by OpenCV.
+    d->cascades << Cascade(cascadeDirs, QString::fromLatin1("lbpcascade_frontalface.xml"));
+
+    // By default, one Haar cascade scans, the other Haar cascades verify
+    d->defaultPrimaryCascades << 2;
+
+    for (int i=0; i<=8; ++i)
+    {
+        d->defaultVerifyingCascades << i;
+    }
 
     d->cascades[5].setROI(0,   0,    0.6, 0.6);
     d->cascades[6].setROI(0.4, 0,    0.6, 0.6);
     d->cascades[7].setROI(0.2, 0.25, 0.6, 0.6);
     d->cascades[8].setROI(0.1, 0.4,  0.8, 0.6);
+
+    for (int i=0; i<d->cascades.size(); ++i)
+    {
+        d->statistics << Private::CascadeStatistics();
+    }
 }
 
 OpenCVFaceDetector::~OpenCVFaceDetector()
@@ -326,105 +682,253 @@ OpenCVFaceDetector::~OpenCVFaceDetector()
 
 double OpenCVFaceDetector::accuracy() const
 {
+    QMutexLocker lock(&d->mutex);
     return d->speedVsAccuracy;
 }
 
 double OpenCVFaceDetector::specificity() const
 {
+    QMutexLocker lock(&d->mutex);
     return d->sensitivityVsSpecificity;
 }
 
+QVariantMap OpenCVFaceDetector::cascadeStatistics() const
+{
+    QMutexLocker lock(&d->statisticsMutex);
+    QVariantMap statistics;
+
+    for (int i=0; i<d->cascades.size(); ++i)
+    {
+        const Private::CascadeStatistics& stats = d->statistics.at(i);
+        QVariantMap entry;
+        entry[QString::fromLatin1("runs")]         = stats.runs;
+        entry[QString::fromLatin1("skipped")]      = stats.skipped;
+        entry[QString::fromLatin1("milliseconds")] = double(stats.nanoseconds) / 1000000;
+        entry[QString::fromLatin1("pixels")]       = stats.pixels;
+        statistics[d->cascades.at(i).name]         = entry;
+    }
+
+    return statistics;
+}
+
 void OpenCVFaceDetector::setAccuracy(double speedVsAccuracy)
 {
-    d->speedVsAccuracy = qBound(0.0, speedVsAccuracy, 1.0);
+    QMutexLocker lock(&d->mutex);
+    const double accuracy = qBound(0.0, speedVsAccuracy, 1.0);
+
+    if (accuracy != d->speedVsAccuracy)
+    {
+        d->speedVsAccuracy = accuracy;
+        d->resetBudget();
+    }
 }
 
 void OpenCVFaceDetector::setSpecificity(double sensitivityVsSpecificity)
 {
+    QMutexLocker lock(&d->mutex);
     d->sensitivityVsSpecificity = qBound(0.0, sensitivityVsSpecificity, 1.0);
 }
 
-void OpenCVFaceDetector::updateParameters(const cv::Size& /*scaledSize*/, const cv::Size& originalSize)
+void OpenCVFaceDetector::setTimeBudget(double milliseconds)
 {
-    double origSize = double(cv::max(originalSize.width, originalSize.height)) / 1000;
-
-    /* Search increment will determine the number of passes over the image.
-     * But with fewer passes, we will miss some faces.
-     */
-    if (d->speedVsAccuracy <= 0.159)
-        d->primaryParams.searchIncrement = 1.5;
-    else if (d->speedVsAccuracy >= 0.8)
-        d->primaryParams.searchIncrement = 1.1;
-    else
-        d->primaryParams.searchIncrement = round(100 * (1.1 - 0.5*log10(d->speedVsAccuracy))) / 100;
+    QMutexLocker lock(&d->mutex);
+    const double budget = qMax(0.0, milliseconds);
 
-    /* This is a clear tradeoff. With 1, we'll get many faces,
-     * but more false positives than faces.
-     * 3 is the best parameter for normal use. */
-    if (d->sensitivityVsSpecificity < 0.25)
-        d->primaryParams.grouping = 1;
-    else if (d->sensitivityVsSpecificity < 0.5)
-        d->primaryParams.grouping = 2;
-    else
-        d->primaryParams.grouping = 3;
+    if (budget != d->timeBudget)
+    {
+        d->timeBudget = budget;
+        d->resetBudget();
+    }
+}
 
-    /* Flag speeds up (very much faster) and potentially lowers sensitivity: We mostly use it,
-     * unless in we want very high sensitivity at low speed
-     */
-    if (d->sensitivityVsSpecificity > 0.1 || d->speedVsAccuracy < 0.9)
-        d->primaryParams.flags = CV_HAAR_DO_CANNY_PRUNING;
-    else
-        d->primaryParams.flags = 0;
+double OpenCVFaceDetector::timeBudget() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->timeBudget;
+}
 
-    /* Greater min size will filter small images, lowering sensitivity, enhancing specificity,
-     * with false positives often small
-     */
-    double minSize = 32 * d->sensitivityVsSpecificity;
+QVariantMap OpenCVFaceDetector::timeBudgetStatus() const
+{
+    QMutexLocker lock(&d->mutex);
+    QVariantMap status;
 
-    /* Original small images deserve a smaller minimum size
-     */
-    minSize -= 10 * (1.0 - cv::min(1.0, origSize));
+    if (d->timeBudget <= 0)
+    {
+        return status;
+    }
 
-    /* A small min size means small starting size, together with search increment, determining
-     * the number of operations and thus speed
-     */
-    if (d->speedVsAccuracy < 0.75)
-        minSize += 100 * (0.75 - d->speedVsAccuracy);
+    status[QString::fromLatin1("milliseconds")]    = d->averageMilliseconds;
+    status[QString::fromLatin1("accuracy")]        = qMin(d->speedVsAccuracy, d->budgetAccuracy);
+    status[QString::fromLatin1("verification")]    = d->budgetVerification;
+    status[QString::fromLatin1("searchIncrement")] = d->budgetSearchIncrement;
+    status[QString::fromLatin1("minSize")]         = d->budgetMinSize;
 
-    /* Cascade minimum is 20 for most of our cascades (one is 24).
-     * Passing 0 will use the cascade minimum.
-     */
-    if (minSize < 20)
-        minSize = 0;
+    return status;
+}
 
-    d->primaryParams.minSize = cv::Size(lround(minSize), lround(minSize));
+void OpenCVFaceDetector::setPrimaryCascades(const QStringList& cascades)
+{
+    const QList<int> indexes = d->cascadeIndexes(cascades);
 
-    d->maxDistance                     = 15;    // Maximum distance between two faces to call them unique
-    d->minDuplicates                   = 0;
+    if (indexes.isEmpty() && !cascades.isEmpty())
+    {
+        qCWarning(LIBKFACE_LOG) << "None of the primary cascades " << cascades << " is available, using the default";
+    }
 
-    d->verifyingParams.searchIncrement = 1.1;
-    d->verifyingParams.flags           = 0;
+    QMutexLocker lock(&d->mutex);
+    d->primaryCascades = indexes;
+}
 
-    // NOTE: min size is adjusted each time
+void OpenCVFaceDetector::setVerifyingCascades(const QStringList& cascades)
+{
+    const QList<int> indexes = d->cascadeIndexes(cascades);
 
-/*
-    qCDebug(LIBKFACE_LOG) << "updateParameters: accuracy " << d->speedVsAccuracy
-             << " sensitivity " << d->sensitivityVsSpecificity
-             << " - searchIncrement " << d->primaryParams.searchIncrement
-             << " grouping " << d->primaryParams.grouping
-             << " flags " << d->primaryParams.flags
-             << " min size " << d->primaryParams.minSize.width << endl
-             << " primary cascades: ";
+    if (indexes.isEmpty() && !cascades.isEmpty())
+    {
+        qCWarning(LIBKFACE_LOG) << "None of the verifying cascades " << cascades << " is available, using the default";
+    }
 
-    for (unsigned int i=0; i<d->cascadeProperties.size(); i++)
-        if (d->cascadeProperties[i].primaryCascade)
-            qCDebug(LIBKFACE_LOG) << d->cascadeSet->getCascade(i).name << " ";
+    QMutexLocker lock(&d->mutex);
+    d->verifyingCascades = indexes;
+}
 
-    qCDebug(LIBKFACE_LOG) << " maxDistance " << d->maxDistance << " minDuplicates " << d->minDuplicates;
-*/
+QStringList OpenCVFaceDetector::primaryCascades() const
+{
+    QList<int> primary, verifying;
+    d->currentCascades(primary, verifying);
+    QStringList names;
+
+    foreach (int i, primary)
+    {
+        names << d->cascades.at(i).name;
+    }
+
+    return names;
+}
+
+QStringList OpenCVFaceDetector::verifyingCascades() const
+{
+    QList<int> primary, verifying;
+    d->currentCascades(primary, verifying);
+    QStringList names;
+
+    foreach (int i, verifying)
+    {
+        names << d->cascades.at(i).name;
+    }
+
+    return names;
+}
+
+DetectionParameters OpenCVFaceDetector::parameters(const cv::Size& scaledSize, const cv::Size& originalSize) const
+{
+    double speedVsAccuracy;
+    double sensitivityVsSpecificity;
+    bool   verify = true;
+
+    {
+        QMutexLocker lock(&d->mutex);
+        speedVsAccuracy          = d->speedVsAccuracy;
+        sensitivityVsSpecificity = d->sensitivityVsSpecificity;
+
+        if (d->timeBudget > 0)
+        {
+            speedVsAccuracy = qMin(speedVsAccuracy, d->budgetAccuracy);
+            verify          = d->budgetVerification;
+        }
+    }
+
+    DetectionParameters params = parameters(scaledSize, originalSize, speedVsAccuracy, sensitivityVsSpecificity);
+    params.verify              = verify;
+
+    return params;
+}
+
+DetectionParameters OpenCVFaceDetector::parameters(const cv::Size& /*scaledSize*/, const cv::Size& originalSize,
+                                                   double speedVsAccuracy, double sensitivityVsSpecificity) const
+{
+    DetectionParameters params;
+    double origSize = double(cv::max(originalSize.width, originalSize.height)) / 1000;
+
+    /* Search increment will determine the number of passes over the image.
+     * But with fewer passes, we will miss some faces.
+     */
+    if (speedVsAccuracy <= 0.159)
+        params.primaryParams.searchIncrement = 1.5;
+    else if (speedVsAccuracy >= 0.8)
+        params.primaryParams.searchIncrement = 1.1;
+    else
+        params.primaryParams.searchIncrement = round(100 * (1.1 - 0.5*log10(speedVsAccuracy))) / 100;
+
+    /* This is a clear tradeoff. With 1, we'll get many faces,
+     * but more false positives than faces.
+     * 3 is the best parameter for normal use. */
+    if (sensitivityVsSpecificity < 0.25)
+        params.primaryParams.grouping = 1;
+    else if (sensitivityVsSpecificity < 0.5)
+        params.primaryParams.grouping = 2;
+    else
+        params.primaryParams.grouping = 3;
+
+    /* Flag speeds up (very much faster) and potentially lowers sensitivity: We mostly use it,
+     * unless in we want very high sensitivity at low speed
+     */
+    if (sensitivityVsSpecificity > 0.1 || speedVsAccuracy < 0.9)
+        params.primaryParams.flags = CV_HAAR_DO_CANNY_PRUNING;
+    else
+        params.primaryParams.flags = 0;
+
+    /* Greater min size will filter small images, lowering sensitivity, enhancing specificity,
+     * with false positives often small
+     */
+    double minSize = 32 * sensitivityVsSpecificity;
+
+    /* Original small images deserve a smaller minimum size
+     */
+    minSize -= 10 * (1.0 - cv::min(1.0, origSize));
+
+    /* A small min size means small starting size, together with search increment, determining
+     * the number of operations and thus speed
+     */
+    if (speedVsAccuracy < 0.75)
+        minSize += 100 * (0.75 - speedVsAccuracy);
+
+    /* Cascade minimum is 20 for most of our cascades (one is 24).
+     * Passing 0 will use the cascade minimum.
+     */
+    if (minSize < 20)
+        minSize = 0;
+
+    params.primaryParams.minSize = cv::Size(lround(minSize), lround(minSize));
+
+    params.minOverlap                      = 0.4;   // Minimum overlap of two faces to call them duplicates
+    params.minDuplicates                   = 0;
+
+    params.verifyingParams.searchIncrement = 1.1;
+    params.verifyingParams.flags           = 0;
+
+    // NOTE: min size and grouping of the verifying cascades are adjusted for each face
+
+    d->currentCascades(params.primaryCascades, params.verifyingCascades);
 
 /*
-    if (d->speedVsAccuracy < 0.5)
+    qCDebug(LIBKFACE_LOG) << "updateParameters: accuracy " << speedVsAccuracy
+             << " sensitivity " << sensitivityVsSpecificity
+             << " - searchIncrement " << params.primaryParams.searchIncrement
+             << " grouping " << params.primaryParams.grouping
+             << " flags " << params.primaryParams.flags
+             << " min size " << params.primaryParams.minSize.width << endl
+             << " primary cascades: ";
+
+    for (unsigned int i=0; i<d->cascadeProperties.size(); i++)
+        if (d->cascadeProperties[i].primaryCascade)
+            qCDebug(LIBKFACE_LOG) << d->cascadeSet->getCascade(i).name << " ";
+
+    qCDebug(LIBKFACE_LOG) << " minOverlap " << params.minOverlap << " minDuplicates " << params.minDuplicates;
+*/
+
+/*
+    if (speedVsAccuracy < 0.5)
     {
         d->primaryCascades[0] = true;
         d->minDuplicates = 0;
@@ -434,15 +938,18 @@ void OpenCVFaceDetector::updateParameters(const cv::Size& /*scaledSize*/, const
         d->primaryCascades[1] = true;
         d->primaryCascades[2] = true;
 
-        if (d->sensitivityVsSpecificity > 0.5)
+        if (sensitivityVsSpecificity > 0.5)
             d->minDuplicates = 1;
     }
 */
+
+    return params;
 }
 
-QList<QRect> OpenCVFaceDetector::cascadeResult(const cv::Mat& inputImage,
-                                               Cascade& cascade,
-                                               const DetectObjectParameters& params) const
+QList<QRect> OpenCVFaceDetector::cascadeResult(const DetectionContext& context, const cv::Rect& roi,
+                                               const Cascade& cascade,
+                                               const DetectObjectParameters& params,
+                                               QList<int>* const neighbors) const
 {
     // Check whether the cascade has loaded successfully. Else report and error and quit
     if (cascade.empty())
@@ -454,18 +961,21 @@ QList<QRect> OpenCVFaceDetector::cascadeResult(const cv::Mat& inputImage,
     // There can be more than one face in an image. So create a growable sequence of faces.
     // Detect the objects and store them in the sequence
 
-    qCDebug(LIBKFACE_LOG) << "detectMultiScale: image size " << inputImage.cols << " " << inputImage.rows
+    qCDebug(LIBKFACE_LOG) << "detectMultiScale: region " << toQRect(roi)
              << " searchIncrement " << params.searchIncrement
              << " grouping " << params.grouping
              << " flags " << params.flags
-             << " min size " << params.minSize.width << " " << params.minSize.height << endl;
+             << " min size " << params.minSize.width << " " << params.minSize.height
+             << " max size " << params.maxSize.width << " " << params.maxSize.height << endl;
 
     std::vector<cv::Rect> faces;
-    cascade.detectMultiScale(inputImage, faces,
+    std::vector<int>      faceNeighbors;
+    cascade.detectMultiScale(context, roi, faces, faceNeighbors,
                              params.searchIncrement,                // Increase search scale by this factor every time
                              params.grouping,                       // Drop groups of less than n detections
                              params.flags,                          // Optionally, pre-test regions by edge detection
-                             params.minSize                         // Minimum face size to look for
+                             params.minSize,                        // Minimum face size to look for
+                             params.maxSize                         // Maximum face size to look for
                             );
 
     QList<QRect> results;
@@ -475,25 +985,41 @@ QList<QRect> OpenCVFaceDetector::cascadeResult(const cv::Mat& inputImage,
         results << toQRect(*it);
     }
 
+    if (neighbors)
+    {
+        neighbors->clear();
+
+        for (std::vector<int>::const_iterator it = faceNeighbors.begin(); it != faceNeighbors.end(); ++it)
+        {
+            *neighbors << *it;
+        }
+    }
+
     qCDebug(LIBKFACE_LOG) << "detectMultiScale gave " << results;
     return results;
 }
 
-bool OpenCVFaceDetector::verifyFace(const cv::Mat& inputImage, const QRect& face) const
+QList<QRect> OpenCVFaceDetector::cascadeResult(const DetectionContext& context, const cv::Rect& roi, int cascade,
+                                               const DetectObjectParameters& params,
+                                               QList<int>* const neighbors) const
 {
-    // check if we need to verify
-    bool hasVerifyingCascade = false;
+    QElapsedTimer timer;
+    timer.start();
 
-    for (int i=0; i<d->cascades.size(); ++i)
-    {
-        if (d->cascades[i].verifyingCascade)
-        {
-            hasVerifyingCascade = true;
-            break;
-        }
-    }
+    const QList<QRect> results = cascadeResult(context, roi, d->cascades.at(cascade), params, neighbors);
+
+    d->addRun(cascade, timer.nsecsElapsed(), qint64(roi.width) * roi.height);
+    return results;
+}
 
-    if (!hasVerifyingCascade)
+bool OpenCVFaceDetector::verifyFace(const DetectionContext& context, const QRect& face, const DetectionParameters& params,
+                                    int* const votes, bool allVotes) const
+{
+    if (votes)
+        *votes = 0;
+
+    // check if we need to verify
+    if (params.verifyingCascades.isEmpty())
         return true;
 
     // Face coordinates. Add a certain margin for the other frontal cascades.
@@ -501,6 +1027,8 @@ bool OpenCVFaceDetector::verifyFace(const cv::Mat& inputImage, const QRect& face
     const cv::Size faceSize = cv::Size(face.width(), face.height());
     const int margin        = cv::min(40, cv::max(faceRect.width, faceRect.height));
 
+    const cv::Mat& inputImage = context.image();
+
     // Clip to bounds of image, after adding the margin
     cv::Rect extendedRect   = cv::Rect(cv::max(0, faceRect.x - margin),
                                        cv::max(0, faceRect.y - margin),
@@ -510,105 +1038,126 @@ bool OpenCVFaceDetector::verifyFace(const cv::Mat& inputImage, const QRect& face
     extendedRect.width      = cv::min(inputImage.cols - extendedRect.x, extendedRect.width);
     extendedRect.height     = cv::min(inputImage.rows - extendedRect.y, extendedRect.height);
 
-
-    // shallow copy by ROI
-    cv::Mat extendedFaceImg = inputImage(extendedRect);
-
+    // The cascades scan regions of the image, sharing the integral images of the context
     QList<QRect> foundFaces;
     int frontalFaceVotes   = 0;
     int facialFeatureVotes = 0;
 
-    for (int i=0; i<d->cascades.size(); ++i)
+    // Schedule the verifying cascades by their measured cost for the region they scan, cheapest first.
+    // Cascades which did not run yet come first, to be measured.
+    std::vector<std::pair<double, int> > schedule;
+    int remainingFrontalVotes = 0;
+    int remainingFeatureVotes = 0;
+
+    foreach (int i, params.verifyingCascades)
     {
-        qCDebug(LIBKFACE_LOG) << "Verifying face " << face << " using cascade " << i;
+        const Cascade& cascade = d->cascades.at(i);
+        const cv::Rect region = cascade.verificationRect(faceRect, extendedRect);
+        schedule.push_back(std::make_pair(d->costPerPixel(i) * region.area(), i));
+
+        if (cascade.isFacialFeature())
+            remainingFeatureVotes++;
+        else
+            remainingFrontalVotes++;
+    }
+
+    std::stable_sort(schedule.begin(), schedule.end());
 
-        if (d->cascades[i].verifyingCascade)
+    // adjusted for each cascade, a local copy
+    DetectObjectParameters verifyingParams = params.verifyingParams;
+    size_t next = 0;
+
+    for ( ; next < schedule.size(); ++next)
+    {
+        // Stop as soon as the outcome of the vote is decided, unless all votes are counted
+        if (!allVotes &&
+            (isVerifiedByVotes(frontalFaceVotes, facialFeatureVotes, faceSize.width) ||
+             !isVerifiedByVotes(frontalFaceVotes   + remainingFrontalVotes,
+                                facialFeatureVotes + remainingFeatureVotes, faceSize.width)))
         {
-            d->verifyingParams.minSize = d->cascades[i].minSizeForFace(faceSize);
+            break;
+        }
 
-            if (d->cascades[i].isFacialFeature())
-            {
-                d->verifyingParams.grouping = 2;
+        const int i            = schedule[next].second;
+        const Cascade& cascade = d->cascades.at(i);
 
-                cv::Rect roi      = d->cascades[i].faceROI(faceRect);
-                cv::Mat  feature  = inputImage(roi);
-                qCDebug(LIBKFACE_LOG) << "feature " << d->cascades[i].roi << toQRect(faceRect) << toQRect(roi);
-                foundFaces        = cascadeResult(feature, d->cascades[i], d->verifyingParams);
+        qCDebug(LIBKFACE_LOG) << "Verifying face " << face << " using cascade " << cascade.name;
 
-                if (!foundFaces.isEmpty())
-                    facialFeatureVotes++;
+        verifyingParams.minSize = cascade.minSizeForFace(faceSize);
+        verifyingParams.maxSize = cascade.maxSizeForFace(faceSize);
+
+        if (cascade.isFacialFeature())
+        {
+            remainingFeatureVotes--;
+            verifyingParams.grouping = 2;
+
+            cv::Rect roi      = cascade.faceROI(faceRect) & cv::Rect(0, 0, inputImage.cols, inputImage.rows);
+            qCDebug(LIBKFACE_LOG) << "feature " << cascade.roi << toQRect(faceRect) << toQRect(roi);
+            foundFaces        = cascadeResult(context, roi, i, verifyingParams);
+
+            if (!foundFaces.isEmpty())
+                facialFeatureVotes++;
 
 /*
-                 * This is pretty much working code that scales up the face if it's too small
-                 * for the  facial feature cascade. It did not bring me benefit with false positives though.
+             * This is pretty much working code that scales up the face if it's too small
+             * for the  facial feature cascade. It did not bring me benefit with false positives though.
 
-                double factor = cascade.requestedInputScaleFactor(faceSize);
-                IplImage* feature = LibFaceUtils::scaledSection(inputImage, roi, factor);
+            double factor = cascade.requestedInputScaleFactor(faceSize);
+            IplImage* feature = LibFaceUtils::scaledSection(inputImage, roi, factor);
 
-                // qCDebug(LIBKFACE_LOG) << "Facial feature in roi " << cascade.roi << "scaled up to" << feature->width << feature->height;
+            // qCDebug(LIBKFACE_LOG) << "Facial feature in roi " << cascade.roi << "scaled up to" << feature->width << feature->height;
 
-                foundFaces = cascadeResult(feature, cascade.cascade, d->verifyingParams);
+            foundFaces = cascadeResult(feature, cascade.cascade, verifyingParams);
 
-                for (vector<Face>::iterator it = foundFaces.begin(); it != foundFaces.end(); ++it)
+            for (vector<Face>::iterator it = foundFaces.begin(); it != foundFaces.end(); ++it)
+            {
+                qCDebug(LIBKFACE_LOG) << "Feature face " << it->getX1() << " " << it->getY1() << " " << it->getWidth() << "x" << it->getHeight();
+
+                double widthScaled = it->getWidth() / factor;
+                double heightScaled = it->getHeight() / factor;
+
+                // qCDebug(LIBKFACE_LOG) << "Hit feature size " << widthScaled << " " << heightScaled << " "
+                //          << (faceSize.width / CascadeProperties::faceToFeatureRelationMin()) << " "
+                //          << (faceSize.width / CascadeProperties::faceToFeatureRelationMax());
+
+                if (
+                    (widthScaled > faceSize.width / Cascade::faceToFeatureRelationMin()
+                     && widthScaled < faceSize.width / Cascade::faceToFeatureRelationMax())
+                    ||
+                    (heightScaled > faceSize.height / Cascade::faceToFeatureRelationMin()
+                     && heightScaled < faceSize.height / Cascade::faceToFeatureRelationMax())
+                    )
                 {
-                    qCDebug(LIBKFACE_LOG) << "Feature face " << it->getX1() << " " << it->getY1() << " " << it->getWidth() << "x" << it->getHeight();
-
-                    double widthScaled = it->getWidth() / factor;
-                    double heightScaled = it->getHeight() / factor;
-
-                    // qCDebug(LIBKFACE_LOG) << "Hit feature size " << widthScaled << " " << heightScaled << " "
-                    //          << (faceSize.width / CascadeProperties::faceToFeatureRelationMin()) << " "
-                    //          << (faceSize.width / CascadeProperties::faceToFeatureRelationMax());
-
-                    if (
-                        (widthScaled > faceSize.width / Cascade::faceToFeatureRelationMin()
-                         && widthScaled < faceSize.width / Cascade::faceToFeatureRelationMax())
-                        ||
-                        (heightScaled > faceSize.height / Cascade::faceToFeatureRelationMin()
-                         && heightScaled < faceSize.height / Cascade::faceToFeatureRelationMax())
-                        )
-                    {
-                        facialFeatureVotes++;
-                        qCDebug(LIBKFACE_LOG) << "voting";
-                        break;
-                    }
+                    facialFeatureVotes++;
+                    qCDebug(LIBKFACE_LOG) << "voting";
+                    break;
                 }
-*/
             }
-            else
-            {
-                d->verifyingParams.grouping = 3;
-
-                foundFaces = cascadeResult(extendedFaceImg, d->cascades[i], d->verifyingParams);
+*/
+        }
+        else
+        {
+            remainingFrontalVotes--;
+            verifyingParams.grouping = 3;
 
-                // We don't need to check the size of found regions, the minSize in verifyingParams is large enough
-                if (!foundFaces.empty())
-                    frontalFaceVotes++;
-            }
+            foundFaces = cascadeResult(context, extendedRect, i, verifyingParams);
 
-            //qCDebug(LIBKFACE_LOG) << "Verifying cascade " << cascade.name << " gives " << foundFaces.size();
+            // We don't need to check the size of found regions, the minSize in verifyingParams is large enough
+            if (!foundFaces.empty())
+                frontalFaceVotes++;
         }
     }
 
-    bool verified;
-
-    // Heuristic: Discard a sufficiently large face that shows no facial features
-    if (faceSize.width <= 50 && facialFeatureVotes == 0)
-    {
-        verified = false;
-    }
-    else
+    for ( ; next < schedule.size(); ++next)
     {
-        if (frontalFaceVotes && facialFeatureVotes)
-            verified = true;
-        else if (frontalFaceVotes >= 2)
-            verified = true;
-        else if (facialFeatureVotes >= 2)
-            verified = true;
-        else
-            verified = false;
+        d->addSkipped(schedule[next].second);
     }
 
+    const bool verified = isVerifiedByVotes(frontalFaceVotes, facialFeatureVotes, faceSize.width);
+
+    if (votes)
+        *votes = frontalFaceVotes + facialFeatureVotes;
+
 /*
     qCDebug(LIBKFACE_LOG) << "Verification finished. Votes: Frontal " << frontalFaceVotes << " Features "
              << facialFeatureVotes << ". Face verified: " << verified;
@@ -617,7 +1166,9 @@ bool OpenCVFaceDetector::verifyFace(const cv::Mat& inputImage, const QRect& face
     return verified;
 }
 
-QList<QRect> OpenCVFaceDetector::mergeFaces(const cv::Mat& inputImage, const QList< QList<QRect> >& combo) const
+QList<QRect> OpenCVFaceDetector::mergeFaces(const cv::Mat& inputImage, const QList< QList<QRect> >& combo,
+                                            const DetectionParameters& params,
+                                            QList<int>* const duplicates, QList<int>* const indices) const
 {
     Q_UNUSED(inputImage);
 
@@ -629,114 +1180,431 @@ QList<QRect> OpenCVFaceDetector::mergeFaces(const cv::Mat& inputImage, const QLi
         results += list;
     }
 
-    // used only one cascade? No need to merge then
-    int primaryCascades = 0;
-
-    foreach (const Cascade& cascade, d->cascades)
+    // used only one cascade on one region? No need to merge then
+    if (combo.size() <= 1)
     {
-        if (cascade.primaryCascade)
-            primaryCascades++;
-    }
+        if (duplicates)
+        {
+            duplicates->clear();
+
+            for (int i = 0; i < results.size(); ++i)
+                *duplicates << 0;
+        }
+
+        if (indices)
+        {
+            indices->clear();
+
+            for (int i = 0; i < results.size(); ++i)
+                *indices << i;
+        }
 
-    if (primaryCascades <= 1)
-    {
         return results;
     }
 
     /*
-     *   Now, starting from the left, take a face and compare with rest. If distance is less than a threshold,
-     *   consider them to be "overlapping" face frames and delete the "duplicate" from the vector.
-     *   Remember that only faces to the RIGHT of the reference face will be deleted.
+     *   Now, in the order of the cascades, take a face and remove the later faces overlapping with it
+     *   as duplicates. The overlap is relative to the face size.
      */
-    QList<int> genuineness;
-    int ctr = 0;
+    results = nonMaximumSuppression(results, params.minOverlap, params.minDuplicates, duplicates, indices);
+
+    qCDebug(LIBKFACE_LOG) << "Faces parsed: " << combo.size() << " lists, number of final faces: " << results.size();
+
+    return results;
+}
+
+int OpenCVFaceDetector::recommendedImageSizeForDetection()
+{
+    return 800;
+}
+
+QSize OpenCVFaceDetector::scaledSizeForDetection(const QSize& size)
+{
+    QSize scaledSize                 = size;
+    int inputArea                    = size.width() * size.height();
+    const int maxAcceptableInputArea = 1024*768;
+
+    if (inputArea > maxAcceptableInputArea)
+    {
+        // Resize to 1024 * 768 (or comparable area for different aspect ratio)
+        // Looking for scale factor z where A = w*z * h*z => z = sqrt(A/(w*h))
+        qreal z    = qSqrt(qreal(maxAcceptableInputArea) / size.width() / size.height());
+        scaledSize = size * z;
+    }
+
+    return scaledSize;
+}
+
+cv::Mat OpenCVFaceDetector::prepareForDetection(const QImage& inputImage) const
+{
+    if (inputImage.isNull() || !inputImage.size().isValid())
+    {
+        return cv::Mat();
+    }
+
+    // Reads the pixels of inputImage in place, scaling and gray conversion in one step
+    cv::Mat cvImage = grayMatFromQImage(inputImage, scaledSizeForDetection(inputImage.size()));
+
+    equalizeHist(cvImage, cvImage);
+    return cvImage;
+}
+
+cv::Mat OpenCVFaceDetector::prepareForDetection(const cv::Mat& grayImage) const
+{
+    if (grayImage.empty())
+    {
+        return cv::Mat();
+    }
+
+    const QSize scaledSize = scaledSizeForDetection(QSize(grayImage.cols, grayImage.rows));
+    cv::Mat cvImage;
+
+    // Nearest neighbor sampling, as for a QImage. Writes to a new matrix, grayImage is not modified.
+    if (scaledSize.width() != grayImage.cols || scaledSize.height() != grayImage.rows)
+    {
+        cv::resize(grayImage, cvImage, cv::Size(scaledSize.width(), scaledSize.height()), 0, 0, cv::INTER_NEAREST);
+        equalizeHist(cvImage, cvImage);
+    }
+    else
+    {
+        equalizeHist(grayImage, cvImage);
+    }
+
+    return cvImage;
+}
 
-    QList<QRect>::iterator first, second;
+/**
+ * Runs one primary scan per loop index.
+ */
+class OpenCVFaceDetector::PrimaryCascadeScan : public cv::ParallelLoopBody
+{
+public:
 
-    for (first = results.begin(); first != results.end(); )
+    PrimaryCascadeScan(const OpenCVFaceDetector* const detector, const DetectionContext& context,
+                       const QList<PrimaryScan>& scans, QList<QRect>* const results, QList<int>* const neighbors)
+        : m_detector(detector),
+          m_context(context),
+          m_scans(scans),
+          m_results(results),
+          m_neighbors(neighbors)
     {
-        int duplicates = 0;
+    }
 
-        for (second = first + 1; second != results.end(); )  // Compare with the faces to the right
+    void operator()(const cv::Range& range) const
+    {
+        for (int i = range.start ; i < range.end ; ++i)
         {
-            ctr++;
+            const PrimaryScan& scan = m_scans.at(i);
 
-            if (distanceOfCenters(*first, *second) < d->maxDistance)
+            try
             {
-                second = results.erase(second);
-                duplicates++;
+                m_results[i].clear();
+
+                // Relative to the region, back to image coordinates
+                foreach (const QRect& face, m_detector->cascadeResult(m_context, scan.roi, scan.cascade, scan.params,
+                                                                      &m_neighbors[i]))
+                {
+                    m_results[i] << face.translated(scan.roi.x, scan.roi.y);
+                }
             }
-            else
+            catch (cv::Exception& e)
+            {
+                qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+            }
+            catch(...)
             {
-                ++second;
+                qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
             }
         }
+    }
 
-        if (duplicates < d->minDuplicates)    // Less duplicates, probably not genuine, kick it out
-        {
-            first = results.erase(first);
-        }
-        else
+private:
+
+    const OpenCVFaceDetector* const m_detector;
+    const DetectionContext&         m_context;
+    const QList<PrimaryScan>&       m_scans;
+    QList<QRect>* const             m_results;
+    QList<int>* const               m_neighbors;
+};
+
+/**
+ * Verifies one candidate face per loop index.
+ */
+class OpenCVFaceDetector::FaceVerification : public cv::ParallelLoopBody
+{
+public:
+
+    FaceVerification(const OpenCVFaceDetector* const detector, const DetectionContext& context,
+                     const QList<QRect>& faces, const DetectionParameters& params,
+                     uchar* const verified, int* const votes, bool allVotes = false)
+        : m_detector(detector),
+          m_context(context),
+          m_faces(faces),
+          m_params(params),
+          m_verified(verified),
+          m_votes(votes),
+          m_allVotes(allVotes)
+    {
+    }
+
+    void operator()(const cv::Range& range) const
+    {
+        for (int i = range.start ; i < range.end ; ++i)
         {
-            // Face passed both tests, will be in final results
-            ++first;
+            try
+            {
+                m_verified[i] = m_detector->verifyFace(m_context, m_faces.at(i), m_params, &m_votes[i], m_allVotes);
+            }
+            catch (cv::Exception& e)
+            {
+                qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+            }
+            catch(...)
+            {
+                qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+            }
         }
     }
 
-    qCDebug(LIBKFACE_LOG) << "Faces parsed: " << ctr << " number of final faces: " << results.size();
+private:
 
-    return results;
+    const OpenCVFaceDetector* const m_detector;
+    const DetectionContext&         m_context;
+    const QList<QRect>&             m_faces;
+    const DetectionParameters&      m_params;
+    uchar* const                    m_verified;
+    int* const                      m_votes;
+    const bool                      m_allVotes;
+};
+
+QList<QRect> OpenCVFaceDetector::detectFaces(const cv::Mat& inputImage, const cv::Size& originalSize) const
+{
+    if (inputImage.empty())
+    {
+        qCDebug(LIBKFACE_LOG) << "Invalid image given, not detecting faces.";
+        return QList<QRect>();
+    }
+
+    const DetectionParameters params = parameters(inputImage.size(), originalSize);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 verificationTime = 0;
+
+    const QList<QRect> faces = detectFaces(inputImage, wholeImageScans(inputImage, params), params, params.verify,
+                                           &verificationTime);
+
+    d->adaptToTime(params, double(timer.nsecsElapsed()) / 1000000, double(verificationTime) / 1000000);
+
+    return faces;
 }
 
-int OpenCVFaceDetector::recommendedImageSizeForDetection()
+QList<QRect> OpenCVFaceDetector::detectCandidates(const cv::Mat& inputImage, const cv::Size& originalSize) const
 {
-    return 800;
+    if (inputImage.empty())
+    {
+        qCDebug(LIBKFACE_LOG) << "Invalid image given, not detecting faces.";
+        return QList<QRect>();
+    }
+
+    double speedVsAccuracy;
+    double sensitivityVsSpecificity;
+
+    {
+        QMutexLocker lock(&d->mutex);
+        speedVsAccuracy          = d->speedVsAccuracy;
+        sensitivityVsSpecificity = d->sensitivityVsSpecificity;
+    }
+
+    // Rather too many candidates than missed faces: the detection in the regions will sort them out
+    const DetectionParameters params = parameters(inputImage.size(), originalSize,
+                                                  speedVsAccuracy, qMin(sensitivityVsSpecificity, 0.3));
+
+    return detectFaces(inputImage, wholeImageScans(inputImage, params), params, false);
 }
 
-cv::Mat OpenCVFaceDetector::prepareForDetection(const QImage& inputImage) const
+QList<FaceCandidate> OpenCVFaceDetector::detectFaceCandidates(const cv::Mat& inputImage, const cv::Size& originalSize) const
 {
-    if (inputImage.isNull() || !inputImage.size().isValid())
+    if (inputImage.empty())
     {
-        return cv::Mat();
+        qCDebug(LIBKFACE_LOG) << "Invalid image given, not detecting faces.";
+        return QList<FaceCandidate>();
     }
 
-    QImage image(inputImage);
-    int inputArea                    = image.width() * image.height();
-    const int maxAcceptableInputArea = 1024*768;
+    const double speedVsAccuracy = accuracy();
+    const int    steps           = 100;
 
-    if (inputArea > maxAcceptableInputArea)
+    // Of the primary parameters, only the edge pruning, the grouping and the minimum size depend on the specificity
+    QList<DetectionParameters> stepParams;
+
+    for (int step = 0; step <= steps; ++step)
     {
-        // Resize to 1024 * 768 (or comparable area for different aspect ratio)
-        // Looking for scale factor z where A = w*z * h*z => z = sqrt(A/(w*h))
-        qreal z          = qSqrt(qreal(maxAcceptableInputArea) / image.width() / image.height());
-        QSize scaledSize = image.size() * z;
-        image            = image.scaled(scaledSize);
+        stepParams << parameters(inputImage.size(), originalSize, speedVsAccuracy, double(step) / steps);
     }
 
-    //TODO: move to common utils, opentldrecognition
-    cv::Mat cvImageWrapper, cvImage;
+    // The integral images are computed once, for all scans and the verification
+    const DetectionContext context(inputImage);
 
-    switch (image.format())
+    /*
+     * One scan without grouping per primary cascade and edge pruning setting, with the smallest minimum size:
+     * the windows of a larger minimum size are a subset, and grouping them again gives the faces of that scan.
+     */
+    QMap<int, std::vector<QList<QRect> > > rawWindows;
+
+    foreach (const DetectionParameters& params, stepParams)
     {
-        case QImage::Format_RGB32:
-        case QImage::Format_ARGB32:
-        case QImage::Format_ARGB32_Premultiplied:
-            // I think we can ignore premultiplication when converting to grayscale
-            cvImageWrapper = cv::Mat(image.height(), image.width(), CV_8UC4, image.scanLine(0), image.bytesPerLine());
-            cvtColor(cvImageWrapper, cvImage, CV_RGBA2GRAY);
-            break;
-        default:
-            image          = image.convertToFormat(QImage::Format_RGB888);
-            cvImageWrapper = cv::Mat(image.height(), image.width(), CV_8UC3, image.scanLine(0), image.bytesPerLine());
-            cvtColor(cvImageWrapper, cvImage, CV_RGB2GRAY);
-            break;
+        if (rawWindows.contains(params.primaryParams.flags))
+        {
+            continue;
+        }
+
+        QList<PrimaryScan> scans = wholeImageScans(inputImage, params);
+
+        for (QList<PrimaryScan>::iterator it = scans.begin(); it != scans.end(); ++it)
+        {
+            it->params.grouping = 0;
+        }
+
+        std::vector<QList<QRect> > windows(scans.size());
+        std::vector<QList<int> >   windowNeighbors(scans.size());
+        PrimaryCascadeScan scan(this, context, scans, windows.data(), windowNeighbors.data());
+
+        if (scans.size() > 1)
+            cv::parallel_for_(cv::Range(0, scans.size()), scan);
+        else
+            scan(cv::Range(0, scans.size()));
+
+        rawWindows.insert(params.primaryParams.flags, windows);
     }
 
-    equalizeHist(cvImage, cvImage);
-    return cvImage;
+    // The merged faces of each step, as detectFaces() finds them before verification
+    QList<QList<QRect> > stepFaces;
+    QList<QList<int> >   stepNeighbors;
+    QList<QList<int> >   stepDuplicates;
+    QList<QRect>         distinctFaces;
+
+    for (int step = 0; step <= steps; ++step)
+    {
+        const DetectObjectParameters& p = stepParams.at(step).primaryParams;
+
+        if (step > 0)
+        {
+            const DetectObjectParameters& previous = stepParams.at(step - 1).primaryParams;
+
+            if (p.flags == previous.flags && p.grouping == previous.grouping && p.minSize == previous.minSize)
+            {
+                stepFaces      << stepFaces.last();
+                stepNeighbors  << stepNeighbors.last();
+                stepDuplicates << stepDuplicates.last();
+                continue;
+            }
+        }
+
+        const std::vector<QList<QRect> >& windows = *rawWindows.constFind(p.flags);
+        QList<QList<QRect> > primaryResults;
+        QList<int>           neighbors;
+
+        for (size_t i = 0; i < windows.size(); ++i)
+        {
+            std::vector<cv::Rect> kept;
+
+            foreach (const QRect& window, windows[i])
+            {
+                if (window.width() >= p.minSize.width && window.height() >= p.minSize.height)
+                {
+                    kept.push_back(fromQRect(window));
+                }
+            }
+
+            std::vector<cv::Rect> objects;
+            std::vector<int>      objectNeighbors;
+            CascadeClassifierPool::groupWindows(kept, p.grouping, objects, objectNeighbors);
+
+            QList<QRect> faces;
+
+            for (size_t j = 0; j < objects.size(); ++j)
+            {
+                faces     << toQRect(objects[j]);
+                neighbors << objectNeighbors[j];
+            }
+
+            primaryResults << faces;
+        }
+
+        QList<int> duplicates;
+        QList<int> indices;
+        const QList<QRect> faces = mergeFaces(inputImage, primaryResults, stepParams.at(step), &duplicates, &indices);
+        QList<int> faceNeighbors;
+
+        foreach (int index, indices)
+        {
+            faceNeighbors << neighbors.value(index);
+        }
+
+        foreach (const QRect& face, faces)
+        {
+            if (!distinctFaces.contains(face))
+            {
+                distinctFaces << face;
+            }
+        }
+
+        stepFaces      << faces;
+        stepNeighbors  << faceNeighbors;
+        stepDuplicates << duplicates;
+    }
+
+    // The verification does not depend on the specificity: each distinct face is verified once, concurrently.
+    // All verifying cascades run, for votes which tell strong faces from weak ones.
+    std::vector<uchar> verified(distinctFaces.size(), 0);
+    std::vector<int>   votes(distinctFaces.size(), 0);
+    FaceVerification verification(this, context, distinctFaces, stepParams.first(), verified.data(), votes.data(), true);
+
+    if (distinctFaces.size() > 1)
+        cv::parallel_for_(cv::Range(0, distinctFaces.size()), verification);
+    else
+        verification(cv::Range(0, distinctFaces.size()));
+
+    // One candidate per face and continuous range of steps reporting it
+    QList<FaceCandidate> candidates;
+    std::vector<int>     lastStep(distinctFaces.size(), -2);
+    std::vector<int>     lastCandidate(distinctFaces.size(), -1);
+
+    for (int step = 0; step <= steps; ++step)
+    {
+        const QList<QRect>& faces = stepFaces.at(step);
+
+        for (int j = 0; j < faces.size(); ++j)
+        {
+            const int k = distinctFaces.indexOf(faces.at(j));
+
+            if (lastStep[k] == step - 1)
+            {
+                candidates[lastCandidate[k]].maxSpecificity = double(step) / steps;
+            }
+            else
+            {
+                FaceCandidate candidate;
+                candidate.rect           = faces.at(j);
+                candidate.neighbors      = stepNeighbors.at(step).at(j);
+                candidate.duplicates     = stepDuplicates.at(step).at(j);
+                candidate.votes          = votes[k];
+                candidate.verified       = verified[k];
+                candidate.minSpecificity = double(step) / steps;
+                candidate.maxSpecificity = double(step) / steps;
+                lastCandidate[k]         = candidates.size();
+                candidates << candidate;
+            }
+
+            lastStep[k] = step;
+        }
+    }
+
+    return candidates;
 }
 
-QList<QRect> OpenCVFaceDetector::detectFaces(const cv::Mat& inputImage, const cv::Size& originalSize)
+QList<QRect> OpenCVFaceDetector::detectFaces(const cv::Mat& inputImage, const QList<QRect>& searchRegions,
+                                             const cv::Size& originalSize, bool verify) const
 {
     if (inputImage.empty())
     {
@@ -744,30 +1612,117 @@ QList<QRect> OpenCVFaceDetector::detectFaces(const cv::Mat& inputImage, const cv
         return QList<QRect>();
     }
 
-    updateParameters(inputImage.size(), originalSize);
-
-    // Now loop through each cascade, apply it, and get back a vector of detected faces
-    QList<QList<QRect> > primaryResults;
-    QList<QRect> results;
+    const DetectionParameters params = parameters(inputImage.size(), originalSize);
+    const cv::Rect imageRect(0, 0, inputImage.cols, inputImage.rows);
+    QList<PrimaryScan> scans;
 
-    for (int i=0; i<d->cascades.size(); ++i)
+    foreach (const QRect& region, searchRegions)
     {
-        if (d->cascades[i].primaryCascade)
+        /*
+         * A face may extend beyond the region given, pad by a quarter of its size on each side.
+         * Look for faces from a quarter of the region size up to the padded region size.
+         */
+        const cv::Rect regionRect = fromQRect(region);
+        const int padX            = regionRect.width  / 4;
+        const int padY            = regionRect.height / 4;
+        const cv::Rect roi        = cv::Rect(regionRect.x - padX, regionRect.y - padY,
+                                             regionRect.width + 2*padX, regionRect.height + 2*padY) & imageRect;
+
+        if (roi.width <= 0 || roi.height <= 0)
+        {
+            continue;
+        }
+
+        foreach (int i, params.primaryCascades)
         {
-            primaryResults << cascadeResult(inputImage, d->cascades[i], d->primaryParams);
+            PrimaryScan scan;
+            scan.cascade        = i;
+            scan.roi            = roi;
+            scan.params         = params.primaryParams;
+            scan.params.minSize = cv::Size(cv::max(scan.params.minSize.width,  regionRect.width  / 4),
+                                           cv::max(scan.params.minSize.height, regionRect.height / 4));
+            scan.params.maxSize = roi.size();
+
+            if (d->cascades.at(i).lessThanWindowSize(scan.params.minSize))
+                scan.params.minSize = cv::Size(0, 0);
+
+            scans << scan;
         }
     }
 
+    return detectFaces(inputImage, scans, params, verify && params.verify);
+}
+
+QList<PrimaryScan> OpenCVFaceDetector::wholeImageScans(const cv::Mat& inputImage, const DetectionParameters& params) const
+{
+    QList<PrimaryScan> scans;
+
+    foreach (int i, params.primaryCascades)
+    {
+        PrimaryScan scan;
+        scan.cascade = i;
+        scan.roi     = cv::Rect(0, 0, inputImage.cols, inputImage.rows);
+        scan.params  = params.primaryParams;
+        scans << scan;
+    }
+
+    return scans;
+}
+
+QList<QRect> OpenCVFaceDetector::detectFaces(const cv::Mat& inputImage, const QList<PrimaryScan>& scans,
+                                             const DetectionParameters& params, bool verify,
+                                             qint64* const verificationTime) const
+{
+    // The integral images are computed once, for all cascades
+    const DetectionContext context(inputImage);
+
+    // Now apply each primary cascade, and get back a vector of detected faces.
+    // The cascades are independent of each other and run concurrently.
+    std::vector<QList<QRect> > primaryScans(scans.size());
+    std::vector<QList<int> >   primaryNeighbors(scans.size());
+    PrimaryCascadeScan scan(this, context, scans, primaryScans.data(), primaryNeighbors.data());
+
+    if (scans.size() > 1)
+        cv::parallel_for_(cv::Range(0, scans.size()), scan);
+    else
+        scan(cv::Range(0, scans.size()));
+
+    QList<QList<QRect> > primaryResults;
+
+    for (size_t i = 0; i < primaryScans.size(); ++i)
+    {
+        primaryResults << primaryScans[i];
+    }
+
     // Merge overlaps of face regions by different cascades.
-    results = mergeFaces(inputImage, primaryResults);
+    const QList<QRect> candidates = mergeFaces(inputImage, primaryResults, params);
 
-    // Verify faces using other cascades
-    for (QList<QRect>::iterator it = results.begin(); it != results.end(); )
+    if (!verify)
     {
-        if (!verifyFace(inputImage, *it))
-            it = results.erase(it);
-        else
-            ++it;
+        return candidates;
+    }
+
+    // Verify faces using other cascades, the candidates concurrently
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<uchar> verified(candidates.size(), 0);
+    std::vector<int>   votes(candidates.size(), 0);
+    FaceVerification verification(this, context, candidates, params, verified.data(), votes.data());
+
+    if (candidates.size() > 1)
+        cv::parallel_for_(cv::Range(0, candidates.size()), verification);
+    else
+        verification(cv::Range(0, candidates.size()));
+
+    if (verificationTime)
+        *verificationTime = timer.nsecsElapsed();
+
+    QList<QRect> results;
+
+    for (int i=0; i<candidates.size(); ++i)
+    {
+        if (verified[i])
+            results << candidates.at(i);
     }
 
     return results;
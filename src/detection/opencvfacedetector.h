@@ -45,13 +45,25 @@
 #include <QList>
 #include <QRect>
 #include <QStringList>
+#include <QVariant>
+
+// Local includes
+
+#include "facedetector.h"
 
 namespace KFaceIface
 {
 
 class Cascade;
+class DetectionContext;
 class DetectObjectParameters;
+class DetectionParameters;
+class PrimaryScan;
 
+/**
+ * The loaded cascades are not modified after construction, and the parameters of a detection
+ * are computed per call: one object can run detections from several threads at the same time.
+ */
 class OpenCVFaceDetector
 {
 public:
@@ -60,7 +72,39 @@ public:
     ~OpenCVFaceDetector();
 
     cv::Mat prepareForDetection(const QImage& inputImage) const;
-    QList<QRect> detectFaces(const cv::Mat& inputImage, const cv::Size& originalSize = cv::Size(0, 0));
+
+    /// Same as above for an 8-bit gray image, which is not modified
+    cv::Mat prepareForDetection(const cv::Mat& grayImage) const;
+
+    /**
+     * Returns the faces found in inputImage, prepared with prepareForDetection(). Thread-safe.
+     */
+    QList<QRect> detectFaces(const cv::Mat& inputImage, const cv::Size& originalSize = cv::Size(0, 0)) const;
+
+    /**
+     * Returns the faces found in the searchRegions of inputImage. A region is padded by a quarter of its
+     * size on each side, and faces from a quarter of the region size up to the padded size are searched.
+     * Faces found in overlapping regions are merged. Without verify, the faces found by the
+     * primary cascades are returned without verification by the other cascades. Thread-safe.
+     */
+    QList<QRect> detectFaces(const cv::Mat& inputImage, const QList<QRect>& searchRegions,
+                             const cv::Size& originalSize = cv::Size(0, 0), bool verify = true) const;
+
+    /**
+     * Returns the regions of inputImage possibly containing faces: the primary cascades run with high
+     * sensitivity and the results are not verified. For a detection in these regions
+     * at higher resolution. Thread-safe.
+     */
+    QList<QRect> detectCandidates(const cv::Mat& inputImage, const cv::Size& originalSize = cv::Size(0, 0)) const;
+
+    /**
+     * Returns all faces found in inputImage for any specificity, verified or not, with the evidence
+     * for each and the range of specificity reporting it. The image is scanned once without grouping,
+     * the windows are grouped again for each specificity. The rects of the candidates are absolute
+     * in inputImage. See FaceDetector::detectFaceCandidates(). Thread-safe.
+     */
+    QList<FaceCandidate> detectFaceCandidates(const cv::Mat& inputImage,
+                                              const cv::Size& originalSize = cv::Size(0, 0)) const;
 
     /**
      * Tunes the parameters.
@@ -70,6 +114,7 @@ public:
      * The value is in the interval [0;1], where 0 means
      * fastest operation and highest sensitivity while 1
      * means best accuracy (slow operation) and high specificity.
+     * Takes effect for detections started afterwards.
      */
     void setAccuracy(double speedVsAccuracy);
     void setSpecificity(double sensitivityVsSpecificity);
@@ -77,40 +122,122 @@ public:
     double accuracy()    const;
     double specificity() const;
 
+    /**
+     * Chooses the cascades, by file name, which scan the image for faces, and which verify the faces found.
+     * Besides the Haar cascades, the LBP cascade "lbpcascade_frontalface.xml" is loaded if installed
+     * with OpenCV; it is several times faster as a primary cascade.
+     * Cascades which are unknown or could not be loaded are ignored. An empty list restores the default:
+     * "haarcascade_frontalface_alt2.xml" scans, and all other Haar cascades verify.
+     * Takes effect for detections started afterwards.
+     */
+    void setPrimaryCascades(const QStringList& cascades);
+    void setVerifyingCascades(const QStringList& cascades);
+
+    QStringList primaryCascades()   const;
+    QStringList verifyingCascades() const;
+
+    /**
+     * Sets a time budget per image, in milliseconds, 0 to switch it off.
+     * The time of each detection in a whole image is measured, and the accuracy used is lowered
+     * below the one set until the average time meets the budget, and raised again when there is room.
+     * If even the lowest accuracy misses the budget, the faces found are not verified.
+     * Setting the accuracy restarts the adaptation.
+     */
+    void   setTimeBudget(double milliseconds);
+    double timeBudget() const;
+
+    /**
+     * Returns the decisions taken to meet the time budget, empty if none is set:
+     * the average "milliseconds" per image, the "accuracy" used, if "verification" runs,
+     * and the resulting "searchIncrement" and "minSize" of the last detection.
+     */
+    QVariantMap timeBudgetStatus() const;
+
+    /**
+     * Returns the work done by each cascade since construction, keyed by cascade file name:
+     * "runs" and "skipped" count the scans done and the verifications left out once the vote
+     * was decided, "milliseconds" and "pixels" sum up the time and the area of the runs.
+     */
+    QVariantMap cascadeStatistics() const;
+
     /**
      * Returns the image size (one dimension)
      * recommended for face detection. If the image is considerably larger, it will be rescaled automatically.
      */
     static int recommendedImageSizeForDetection();
 
+    /**
+     * Returns the size to which prepareForDetection() scales an image of size.
+     * Images read at this size are not scaled again.
+     */
+    static QSize scaledSizeForDetection(const QSize& size);
+
 private:
 
     /**
      *  Detect faces in an image using a single cascade. Uses CANNY_PRUNING at present.
      *
-     *  @param inputImage A pointer to the IplImage representing image of interest.
-     *  @param casc The CvClassClassifierCascade pointer to be used for the detection
+     *  @param context The image of interest, and its integral images
+     *  @param roi The region of the image to scan. The returned faces are relative to it.
+     *  @param cascade The cascade to be used for the detection
      *  @param params The parameters to be used for detection
+     *  @param neighbors If given, receives the number of raw detections grouped into each face
      *  @return Returns a vector of Face objects. Each object hold information about 1 face.
      */
-    QList<QRect> cascadeResult(const cv::Mat& inputImage, Cascade& cascade, const DetectObjectParameters& params) const;
+    QList<QRect> cascadeResult(const DetectionContext& context, const cv::Rect& roi,
+                               const Cascade& cascade, const DetectObjectParameters& params,
+                               QList<int>* const neighbors = 0) const;
 
-    bool verifyFace(const cv::Mat& inputImage, const QRect& face) const;
+    /// Same as above for the cascade at index, adding the time taken to its statistics
+    QList<QRect> cascadeResult(const DetectionContext& context, const cv::Rect& roi,
+                               int cascade, const DetectObjectParameters& params,
+                               QList<int>* const neighbors = 0) const;
+
+    /**
+     * Verifies a face with the secondary cascades; votes, if given, receives the number of cascades which found it.
+     * The verification stops once its outcome is decided, unless allVotes is set: then all cascades run.
+     */
+    bool verifyFace(const DetectionContext& context, const QRect& face, const DetectionParameters& params,
+                    int* const votes = 0, bool allVotes = false) const;
 
     /**
      * Returns the faces from the detection results of multiple cascades
      *
      * @param combo A vector of a vector of faces, each component vector is the detection result of a single cascade
-     * @param maxdist The maximum allowable distance between two duplicates, if two faces are further apart than this, they are not duplicates
-     * @param mindups The minimum number of duplicate detections required for a face to qualify as genuine
+     * @param params minOverlap, the minimum overlap of two duplicates relative to their size,
+     *               and minDuplicates, the minimum number of duplicate detections required for a face to qualify as genuine
+     * @param duplicates If given, receives the number of duplicates merged into each face
+     * @param indices If given, receives the index of each face in the concatenated results
      * @return The vector of the final faces
      */
-    QList<QRect> mergeFaces(const cv::Mat& inputImage, const QList< QList<QRect> >& preliminaryResults) const;
+    QList<QRect> mergeFaces(const cv::Mat& inputImage, const QList< QList<QRect> >& preliminaryResults,
+                            const DetectionParameters& params,
+                            QList<int>* const duplicates = 0, QList<int>* const indices = 0) const;
 
-    void updateParameters(const cv::Size& scaledSize, const cv::Size& originalSize);
+    /**
+     * Returns the parameters for a detection in an image of scaledSize,
+     * downscaled from originalSize, with the current accuracy and specificity,
+     * or with the values given.
+     */
+    DetectionParameters parameters(const cv::Size& scaledSize, const cv::Size& originalSize) const;
+    DetectionParameters parameters(const cv::Size& scaledSize, const cv::Size& originalSize,
+                                   double speedVsAccuracy, double sensitivityVsSpecificity) const;
+
+    /// The scans of all primary cascades over the whole image
+    QList<PrimaryScan> wholeImageScans(const cv::Mat& inputImage, const DetectionParameters& params) const;
+
+    /// Runs the primary scans, merges their results and optionally verifies them.
+    /// If verifying, verificationTime receives the nanoseconds spent verifying.
+    QList<QRect> detectFaces(const cv::Mat& inputImage, const QList<PrimaryScan>& scans,
+                             const DetectionParameters& params, bool verify,
+                             qint64* const verificationTime = 0) const;
 
 private:
 
+    // cv::ParallelLoopBody implementations for the primary scan and the verification
+    class PrimaryCascadeScan;
+    class FaceVerification;
+
     class Private;
     Private* const d;
 };
@@ -30,13 +30,24 @@
 
 // Qt includes
 
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QMutex>
+#include <QtCore/qmath.h>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QSharedData>
+#include <QSharedPointer>
 #include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
 
 // Local includes
 
 #include "libkface_debug.h"
 #include "facedetector.h"
+#include "nonmaximumsuppression.h"
 
 namespace KFaceIface
 {
@@ -55,8 +66,14 @@ public:
         delete m_backend;
     }
 
+    /**
+     * Creates the backend on first use. The backend itself is thread-safe,
+     * so the returned pointer can be used without holding the lock.
+     */
     OpenCVFaceDetector* backend()
     {
+        QMutexLocker lock(&m_mutex);
+
         if (!m_backend)
         {
             QStringList cascadeDirs;
@@ -71,6 +88,11 @@ public:
             // Last try to find OpenCV shared files, using cmake env variables.
             cascadeDirs << QString::fromLatin1("%1/haarcascades").arg(QString::fromLatin1(OPENCV_ROOT_PATH));
 
+            // LBP cascades are not shipped with libkface, only installed by OpenCV.
+            cascadeDirs << QStandardPaths::locateAll(QStandardPaths::ApplicationsLocation, QString::fromLatin1("../OpenCV/lbpcascades"), QStandardPaths::LocateDirectory);
+            cascadeDirs << QStandardPaths::locateAll(QStandardPaths::ApplicationsLocation, QString::fromLatin1("../opencv/lbpcascades"), QStandardPaths::LocateDirectory);
+            cascadeDirs << QString::fromLatin1("%1/lbpcascades").arg(QString::fromLatin1(OPENCV_ROOT_PATH));
+
             qCDebug(LIBKFACE_LOG) << "Try to find OpenCV Haar Cascade files in these directories: " << cascadeDirs;
 
             m_backend = new OpenCVFaceDetector(cascadeDirs);
@@ -82,45 +104,457 @@ public:
 
     const OpenCVFaceDetector* constBackend() const
     {
+        QMutexLocker lock(&m_mutex);
         return m_backend;
     }
 
+    void setParameters(const QVariantMap& parameters)
+    {
+        QMutexLocker lock(&m_mutex);
+
+        for (QVariantMap::const_iterator it = parameters.constBegin(); it != parameters.constEnd(); ++it)
+        {
+            // read-only, see parameters()
+            if (it.key() == QString::fromLatin1("cascadeStatistics") ||
+                it.key() == QString::fromLatin1("timeBudgetStatus"))
+            {
+                continue;
+            }
+
+            m_parameters.insert(it.key(), it.value());
+        }
+
+        applyParameters();
+    }
+
+    QVariantMap parameters() const
+    {
+        QMutexLocker lock(&m_mutex);
+        QVariantMap parameters = m_parameters;
+
+        if (m_backend)
+        {
+            parameters.insert(QString::fromLatin1("cascadeStatistics"), m_backend->cascadeStatistics());
+
+            const QVariantMap budgetStatus = m_backend->timeBudgetStatus();
+
+            if (!budgetStatus.isEmpty())
+            {
+                parameters.insert(QString::fromLatin1("timeBudgetStatus"), budgetStatus);
+            }
+        }
+
+        return parameters;
+    }
+
+private:
+
+    /// Call with m_mutex locked
     void applyParameters()
     {
         if (!m_backend)
         {
             return;
         }
+
         for (QVariantMap::const_iterator it = m_parameters.constBegin(); it != m_parameters.constEnd(); ++it)
         {
             if (it.key() == QString::fromLatin1("accuracy"))
             {
-                backend()->setAccuracy(it.value().toDouble());
+                m_backend->setAccuracy(it.value().toDouble());
             }
             else if (it.key() == QString::fromLatin1("speed"))
             {
-                backend()->setAccuracy(1.0 - it.value().toDouble());
+                m_backend->setAccuracy(1.0 - it.value().toDouble());
             }
             else if (it.key() == QString::fromLatin1("specificity"))
             {
-                backend()->setSpecificity(it.value().toDouble());
+                m_backend->setSpecificity(it.value().toDouble());
             }
             else if (it.key() == QString::fromLatin1("sensitivity"))
             {
-                backend()->setSpecificity(1.0 - it.value().toDouble());
+                m_backend->setSpecificity(1.0 - it.value().toDouble());
+            }
+            else if (it.key() == QString::fromLatin1("primaryCascades"))
+            {
+                m_backend->setPrimaryCascades(it.value().toStringList());
+            }
+            else if (it.key() == QString::fromLatin1("verifyingCascades"))
+            {
+                m_backend->setVerifyingCascades(it.value().toStringList());
+            }
+            else if (it.key() == QString::fromLatin1("timeBudget"))
+            {
+                m_backend->setTimeBudget(it.value().toDouble());
             }
         }
     }
 
-public:
+private:
 
+    mutable QMutex      m_mutex;
     QVariantMap         m_parameters;
+    OpenCVFaceDetector* m_backend;
+};
+
+// ---------------------------------------------------------------------------------
+
+namespace
+{
+
+/**
+ * Detection of the faces of one image of a batch.
+ * Frees a slot of the semaphore when done, to bound the number of images in memory.
+ */
+class DetectionTask : public QRunnable
+{
+public:
+
+    DetectionTask(const FaceDetector& detector, const QImage& image,
+                  const QSharedPointer<QList<QRectF> >& result, QSemaphore* const freeSlots)
+        : m_detector(detector),
+          m_image(image),
+          m_result(result),
+          m_freeSlots(freeSlots)
+    {
+    }
+
+    void run()
+    {
+        *m_result = m_detector.detectFaces(m_image);
+        m_image   = QImage();
+        m_freeSlots->release();
+    }
 
 private:
 
-    OpenCVFaceDetector* m_backend;
+    FaceDetector                      m_detector;
+    QImage                            m_image;
+    QSharedPointer<QList<QRectF> >    m_result;
+    QSemaphore* const                 m_freeSlots;
+};
+
+/**
+ * Reads a region of a large image, scaled to a given size.
+ */
+class TileSource
+{
+public:
+
+    virtual ~TileSource()
+    {
+    }
+
+    virtual QSize  size() const                                                 = 0;
+    virtual QImage tile(const QRect& sourceRect, const QSize& scaledSize) const = 0;
+};
+
+class QImageTileSource : public TileSource
+{
+public:
+
+    explicit QImageTileSource(const QImage& image)
+        : m_image(image)
+    {
+    }
+
+    QSize size() const
+    {
+        return m_image.size();
+    }
+
+    QImage tile(const QRect& sourceRect, const QSize& scaledSize) const
+    {
+        if (sourceRect == m_image.rect())
+        {
+            if (m_image.size() == scaledSize)
+            {
+                return m_image;
+            }
+
+            // The overview: scaled without a copy of the whole image, and sampled
+            // by nearest neighbor like prepareForDetection() does
+            return m_image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        }
+
+        const QImage region = m_image.copy(sourceRect);
+
+        if (region.size() == scaledSize)
+        {
+            return region;
+        }
+
+        return region.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+private:
+
+    QImage m_image;
 };
 
+/**
+ * Decodes each tile from file, for formats supporting clipped reading, like JPEG:
+ * the image is never decoded as a whole. Each read still decodes the file from the top
+ * down to the end of its region, so the tiles are read one after the other.
+ */
+class FileTileSource : public TileSource
+{
+public:
+
+    explicit FileTileSource(const QString& filePath)
+        : m_filePath(filePath)
+    {
+        m_size = QImageReader(filePath).size();
+    }
+
+    QSize size() const
+    {
+        return m_size;
+    }
+
+    QImage tile(const QRect& sourceRect, const QSize& scaledSize) const
+    {
+        QImageReader reader(m_filePath);
+        reader.setClipRect(sourceRect);
+        reader.setScaledSize(scaledSize);
+
+        QImage image = reader.read();
+
+        if (image.isNull())
+        {
+            qCWarning(LIBKFACE_LOG) << "Failed to read region" << sourceRect << "of" << m_filePath << ":" << reader.errorString();
+        }
+
+        return image;
+    }
+
+private:
+
+    QString m_filePath;
+    QSize   m_size;
+};
+
+/**
+ * Returns the source reading the tiles of filePath. For formats which cannot read a region,
+ * like PNG or TIFF, each tile read would decode the whole image: it is decoded once instead.
+ */
+QSharedPointer<TileSource> tileSourceForFile(const QString& filePath)
+{
+    if (QImageReader(filePath).supportsOption(QImageIOHandler::ClipRect))
+    {
+        return QSharedPointer<TileSource>(new FileTileSource(filePath));
+    }
+
+    QImageReader reader(filePath);
+    const QImage image = reader.read();
+
+    if (image.isNull())
+    {
+        qCWarning(LIBKFACE_LOG) << "Failed to read" << filePath << ":" << reader.errorString();
+    }
+
+    return QSharedPointer<TileSource>(new QImageTileSource(image));
+}
+
+/**
+ * Returns the start positions of tiles of tileLength, overlapping by at least overlap, covering length.
+ */
+QList<int> tilePositions(int length, int tileLength, int overlap)
+{
+    QList<int> positions;
+
+    if (length <= tileLength)
+    {
+        positions << 0;
+        return positions;
+    }
+
+    const int tiles = 1 + (length - tileLength + (tileLength - overlap) - 1) / (tileLength - overlap);
+
+    for (int i = 0 ; i < tiles ; ++i)
+    {
+        // Distributed evenly, the last one ending at the end
+        positions << qRound(double(i) * (length - tileLength) / (tiles - 1));
+    }
+
+    return positions;
+}
+
+/**
+ * The implementation of FaceDetector::detectFacesTiled() on any source.
+ */
+QList<QRectF> detectFacesInTiles(FaceDetector& detector, const TileSource& source, double scale, int maxThreads)
+{
+    const QSize fullSize = source.size();
+
+    if (fullSize.isEmpty())
+    {
+        return QList<QRectF>();
+    }
+
+    /*
+     * The tiles have the largest size scanned without downscaling. The image, scaled to the chosen
+     * resolution, is covered with tiles overlapping by tileOverlap: each face up to this size is
+     * fully contained in the tile owning its center, the tile's part of the image up to half the
+     * overlap into its neighbors. Larger faces are found by a scan of the whole image downscaled.
+     */
+    const int tileWidth   = 1024;
+    const int tileHeight  = 768;
+    const int tileOverlap = 256;
+
+    scale                  = qBound(0.01, scale, 1.0);
+    const QSize scaledSize = QSize(qMax(1, qRound(fullSize.width()  * scale)),
+                                   qMax(1, qRound(fullSize.height() * scale)));
+    const QList<int> xs    = tilePositions(scaledSize.width(),  tileWidth,  tileOverlap);
+    const QList<int> ys    = tilePositions(scaledSize.height(), tileHeight, tileOverlap);
+    const int threads      = maxThreads > 0 ? maxThreads : qMax(1, QThread::idealThreadCount());
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QSemaphore freeSlots(2 * threads);
+    QList<QRect> tileRects;
+    QList<QRect> coreRects;
+    QList<QSharedPointer<QList<QRectF> > > pending;
+
+    for (int j = 0 ; j < ys.size() ; ++j)
+    {
+        for (int i = 0 ; i < xs.size() ; ++i)
+        {
+            const QRect tileRect = QRect(xs.at(i), ys.at(j),
+                                         qMin(tileWidth,  scaledSize.width()  - xs.at(i)),
+                                         qMin(tileHeight, scaledSize.height() - ys.at(j)));
+
+            // The part of the image this tile is responsible for, ending in the middle of the overlaps
+            const int left   = (i == 0)             ? 0                   : (xs.at(i-1) + tileWidth  + xs.at(i)) / 2;
+            const int top    = (j == 0)             ? 0                   : (ys.at(j-1) + tileHeight + ys.at(j)) / 2;
+            const int right  = (i == xs.size() - 1) ? scaledSize.width()  : (tileRect.x() + tileWidth  + xs.at(i+1)) / 2;
+            const int bottom = (j == ys.size() - 1) ? scaledSize.height() : (tileRect.y() + tileHeight + ys.at(j+1)) / 2;
+
+            const QRect sourceRect = QRect(QPoint(int(tileRect.left()      / scale),     int(tileRect.top()        / scale)),
+                                           QPoint(int((tileRect.right()+1) / scale) - 1, int((tileRect.bottom()+1) / scale) - 1))
+                                     & QRect(QPoint(0, 0), fullSize);
+
+            freeSlots.acquire();
+
+            QSharedPointer<QList<QRectF> > faces(new QList<QRectF>);
+            pending   << faces;
+            tileRects << tileRect;
+            coreRects << QRect(QPoint(left, top), QPoint(right - 1, bottom - 1));
+            pool.start(new DetectionTask(detector, source.tile(sourceRect, tileRect.size()), faces, &freeSlots));
+        }
+    }
+
+    // The overview, at the size the detector would downscale to anyway
+    QList<QRectF> overviewFaces;
+
+    if (pending.size() > 1)
+    {
+        const double overviewScale = qMin(1.0, qSqrt(double(tileWidth) * tileHeight / fullSize.width() / fullSize.height()));
+        const QSize overviewSize   = QSize(qMax(1, qRound(fullSize.width()  * overviewScale)),
+                                           qMax(1, qRound(fullSize.height() * overviewScale)));
+        overviewFaces              = detector.detectFaces(source.tile(QRect(QPoint(0, 0), fullSize), overviewSize), fullSize);
+    }
+
+    pool.waitForDone();
+
+    // Tile results first: at higher resolution, they take precedence over overlapping overview results
+    QList<QRect> faces;
+
+    for (int k = 0 ; k < pending.size() ; ++k)
+    {
+        foreach (const QRect& face, FaceDetector::toAbsoluteRects(*pending.at(k), tileRects.at(k).size()))
+        {
+            const QRect imageFace = face.translated(tileRects.at(k).topLeft());
+
+            if (coreRects.at(k).contains(imageFace.center()))
+            {
+                faces << imageFace;
+            }
+        }
+    }
+
+    foreach (const QRect& face, FaceDetector::toAbsoluteRects(overviewFaces, scaledSize))
+    {
+        if (qMax(face.width(), face.height()) > tileOverlap / 2)
+        {
+            faces << face;
+        }
+    }
+
+    // Faces at the seams can still be found twice
+    return FaceDetector::toRelativeRects(nonMaximumSuppression(faces, 0.4), scaledSize);
+}
+
+/**
+ * The implementation of FaceDetector::detectFacesCoarseToFine() on any source.
+ */
+QList<QRectF> detectCoarseToFine(const OpenCVFaceDetector* const backend, const QImage& thumbnail, const TileSource& source)
+{
+    const QSize fullSize = source.size();
+
+    if (thumbnail.isNull() || fullSize.isEmpty())
+    {
+        return QList<QRectF>();
+    }
+
+    const cv::Size cvFullSize(fullSize.width(), fullSize.height());
+
+    // Stage one: candidates on the thumbnail, with high sensitivity
+    const cv::Mat thumbnailImage   = backend->prepareForDetection(thumbnail);
+    const QList<QRectF> candidates = FaceDetector::toRelativeRects(backend->detectCandidates(thumbnailImage, cvFullSize),
+                                                                   QSize(thumbnailImage.cols, thumbnailImage.rows));
+
+    qCDebug(LIBKFACE_LOG) << "Coarse-to-fine detection:" << candidates.size() << "candidates in thumbnail";
+
+    // Stage two: each candidate region at full resolution
+    QList<QRect> faces;
+
+    foreach (const QRectF& candidate, candidates)
+    {
+        // The thumbnail gives only a coarse position: read half the candidate size around it
+        const QRect candidateRect = FaceDetector::toAbsoluteRect(candidate, fullSize);
+        const int marginX         = candidateRect.width()  / 2;
+        const int marginY         = candidateRect.height() / 2;
+        const QRect sourceRect    = candidateRect.adjusted(-marginX, -marginY, marginX, marginY) & QRect(QPoint(0, 0), fullSize);
+
+        if (sourceRect.isEmpty())
+        {
+            continue;
+        }
+
+        // Large regions are read downscaled to what the detector scans without scaling
+        const double scale       = qMin(1.0, qSqrt(1024.0 * 768.0 / sourceRect.width() / sourceRect.height()));
+        const QSize regionSize   = QSize(qMax(1, qRound(sourceRect.width()  * scale)),
+                                         qMax(1, qRound(sourceRect.height() * scale)));
+        const cv::Mat regionImage = backend->prepareForDetection(source.tile(sourceRect, regionSize));
+
+        if (regionImage.empty())
+        {
+            continue;
+        }
+
+        const double factorX     = double(regionImage.cols) / sourceRect.width();
+        const double factorY     = double(regionImage.rows) / sourceRect.height();
+        const QRect searchRegion = QRectF((candidateRect.x() - sourceRect.x()) * factorX,
+                                          (candidateRect.y() - sourceRect.y()) * factorY,
+                                          candidateRect.width()  * factorX,
+                                          candidateRect.height() * factorY).toRect();
+
+        foreach (const QRect& face, backend->detectFaces(regionImage, QList<QRect>() << searchRegion, cvFullSize))
+        {
+            faces << QRectF(sourceRect.x() + face.x()      / factorX,
+                            sourceRect.y() + face.y()      / factorY,
+                                             face.width()  / factorX,
+                                             face.height() / factorY).toRect();
+        }
+    }
+
+    // Regions of neighboring candidates overlap
+    return FaceDetector::toRelativeRects(nonMaximumSuppression(faces, 0.4), fullSize);
+}
+
+} // namespace
+
 // ---------------------------------------------------------------------------------
 
 FaceDetector::FaceDetector()
@@ -165,8 +599,9 @@ QList<QRectF> FaceDetector::detectFaces(const QImage& image, const QSize& origin
             cvOriginalSize = cv::Size(image.width(), image.height());
         }
 
-        cv::Mat cvImage       = d->backend()->prepareForDetection(image);
-        QList<QRect> absRects = d->backend()->detectFaces(cvImage, cvOriginalSize);
+        const OpenCVFaceDetector* const backend = d->backend();
+        cv::Mat cvImage                         = backend->prepareForDetection(image);
+        QList<QRect> absRects                   = backend->detectFaces(cvImage, cvOriginalSize);
         result                = toRelativeRects(absRects, QSize(cvImage.cols, cvImage.rows));
 
     }
@@ -182,25 +617,269 @@ QList<QRectF> FaceDetector::detectFaces(const QImage& image, const QSize& origin
     return result;
 }
 
-void FaceDetector::setParameter(const QString& parameter, const QVariant& value)
+QList<QRectF> FaceDetector::detectFaces(const cv::Mat& grayImage)
 {
-    d->m_parameters.insert(parameter, value);
-    d->applyParameters();
+    QList<QRectF> result;
+
+    try
+    {
+        const OpenCVFaceDetector* const backend = d->backend();
+        cv::Mat cvImage                         = backend->prepareForDetection(grayImage);
+        QList<QRect> absRects                   = backend->detectFaces(cvImage, grayImage.size());
+        result                                  = toRelativeRects(absRects, QSize(cvImage.cols, cvImage.rows));
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    return result;
 }
 
-void FaceDetector::setParameters(const QVariantMap& parameters)
+QList<QRectF> FaceDetector::detectFaces(const QString& filePath)
 {
-    for (QVariantMap::const_iterator it = parameters.begin(); it != parameters.end(); ++it)
+    QImageReader reader(filePath);
+    const QSize originalSize = reader.size();
+
+    // Known without decoding for most formats. Decode at the size the detection scales to.
+    if (originalSize.isValid())
+    {
+        reader.setScaledSize(OpenCVFaceDetector::scaledSizeForDetection(originalSize));
+    }
+
+    const QImage image = reader.read();
+
+    if (image.isNull())
+    {
+        qCWarning(LIBKFACE_LOG) << "Failed to read" << filePath << ":" << reader.errorString();
+        return QList<QRectF>();
+    }
+
+    return detectFaces(image, originalSize.isValid() ? originalSize : image.size());
+}
+
+QList<QRectF> FaceDetector::detectFaces(const QImage& image, const QList<QRectF>& searchRegions, const QSize& originalSize)
+{
+    return detectFaces(image, searchRegions, originalSize, true);
+}
+
+QList<QRectF> FaceDetector::detectFaces(const QImage& image, const QList<QRectF>& searchRegions, const QSize& originalSize,
+                                        bool verify)
+{
+    QList<QRectF> result;
+
+    if (searchRegions.isEmpty())
     {
-        d->m_parameters.insert(it.key(), it.value());
+        return result;
     }
 
-    d->applyParameters();
+    try
+    {
+        cv::Size cvOriginalSize;
+
+        if (originalSize.isValid())
+        {
+            cvOriginalSize = cv::Size(originalSize.width(), originalSize.height());
+        }
+        else
+        {
+            cvOriginalSize = cv::Size(image.width(), image.height());
+        }
+
+        const OpenCVFaceDetector* const backend = d->backend();
+        cv::Mat cvImage                         = backend->prepareForDetection(image);
+        const QSize cvImageSize                 = QSize(cvImage.cols, cvImage.rows);
+        QList<QRect> absRects                   = backend->detectFaces(cvImage, toAbsoluteRects(searchRegions, cvImageSize),
+                                                                       cvOriginalSize, verify);
+        result                                  = toRelativeRects(absRects, cvImageSize);
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    return result;
+}
+
+QList<FaceCandidate> FaceDetector::detectFaceCandidates(const QImage& image, const QSize& originalSize)
+{
+    QList<FaceCandidate> result;
+
+    try
+    {
+        cv::Size cvOriginalSize;
+
+        if (originalSize.isValid())
+        {
+            cvOriginalSize = cv::Size(originalSize.width(), originalSize.height());
+        }
+        else
+        {
+            cvOriginalSize = cv::Size(image.width(), image.height());
+        }
+
+        const OpenCVFaceDetector* const backend = d->backend();
+        cv::Mat cvImage                         = backend->prepareForDetection(image);
+        const QSize cvImageSize                 = QSize(cvImage.cols, cvImage.rows);
+        result                                  = backend->detectFaceCandidates(cvImage, cvOriginalSize);
+
+        for (QList<FaceCandidate>::iterator it = result.begin(); it != result.end(); ++it)
+        {
+            it->rect = toRelativeRect(it->rect.toRect(), cvImageSize);
+        }
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    return result;
+}
+
+QList<QRectF> FaceDetector::filterCandidates(const QList<FaceCandidate>& candidates, double sensitivityVsSpecificity)
+{
+    QList<QRectF> result;
+
+    // The steps in which detectFaceCandidates() evaluates the specificity
+    const double specificity = qRound(qBound(0.0, sensitivityVsSpecificity, 1.0) * 100) / 100.0;
+
+    foreach (const FaceCandidate& candidate, candidates)
+    {
+        if (candidate.verified && candidate.minSpecificity <= specificity && specificity <= candidate.maxSpecificity)
+        {
+            result << candidate.rect;
+        }
+    }
+
+    return result;
+}
+
+QList<QList<QRectF> > FaceDetector::detectFaces(ImageListProvider* const images, int maxThreads)
+{
+    QList<QList<QRectF> > result;
+
+    if (!images)
+    {
+        return result;
+    }
+
+    const int threads = maxThreads > 0 ? maxThreads : qMax(1, QThread::idealThreadCount());
+
+    // Load the cascades once, before the workers start
+    d->backend();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QSemaphore freeSlots(2 * threads);
+    QList<QSharedPointer<QList<QRectF> > > pending;
+
+    for ( ; !images->atEnd() ; images->proceed())
+    {
+        freeSlots.acquire();
+
+        QSharedPointer<QList<QRectF> > faces(new QList<QRectF>);
+        pending << faces;
+        pool.start(new DetectionTask(*this, images->image(), faces, &freeSlots));
+    }
+
+    pool.waitForDone();
+
+    foreach (const QSharedPointer<QList<QRectF> >& faces, pending)
+    {
+        result << *faces;
+    }
+
+    return result;
+}
+
+QList<QList<QRectF> > FaceDetector::detectFaces(const QList<QImage>& images, int maxThreads)
+{
+    QListImageListProvider provider(images);
+
+    return detectFaces(&provider, maxThreads);
+}
+
+QList<QRectF> FaceDetector::detectFacesTiled(const QImage& image, double scale, int maxThreads)
+{
+    QImageTileSource source(image);
+
+    return detectFacesInTiles(*this, source, scale, maxThreads);
+}
+
+QList<QRectF> FaceDetector::detectFacesTiled(const QString& filePath, double scale, int maxThreads)
+{
+    const QSharedPointer<TileSource> source = tileSourceForFile(filePath);
+
+    return detectFacesInTiles(*this, *source, scale, maxThreads);
+}
+
+QList<QRectF> FaceDetector::detectFacesCoarseToFine(const QImage& thumbnail, const QImage& fullImage)
+{
+    QImageTileSource source(fullImage);
+
+    try
+    {
+        return detectCoarseToFine(d->backend(), thumbnail, source);
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    return QList<QRectF>();
+}
+
+QList<QRectF> FaceDetector::detectFacesCoarseToFine(const QImage& thumbnail, const QString& filePath)
+{
+    const QSharedPointer<TileSource> source = tileSourceForFile(filePath);
+
+    try
+    {
+        return detectCoarseToFine(d->backend(), thumbnail, *source);
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    return QList<QRectF>();
+}
+
+void FaceDetector::setParameter(const QString& parameter, const QVariant& value)
+{
+    QVariantMap parameters;
+    parameters.insert(parameter, value);
+    d->setParameters(parameters);
+}
+
+void FaceDetector::setParameters(const QVariantMap& parameters)
+{
+    d->setParameters(parameters);
 }
 
 QVariantMap FaceDetector::parameters() const
 {
-    return d->m_parameters;
+    return d->parameters();
 }
 
 int FaceDetector::recommendedImageSize(const QSize& availableSize) const
@@ -34,15 +34,73 @@
 
 #include <QExplicitlySharedDataPointer>
 #include <QImage>
+#include <QList>
+#include <QRectF>
 #include <QVariant>
 
 // Local includes
 
 #include "libkface_export.h"
+#include "dataproviders.h"
+
+namespace cv
+{
+class Mat;
+}
 
 namespace KFaceIface
 {
 
+/**
+ * A face found by FaceDetector::detectFaceCandidates(), with the evidence for it.
+ */
+class FaceCandidate
+{
+public:
+
+    FaceCandidate()
+        : neighbors(0),
+          duplicates(0),
+          votes(0),
+          verified(false),
+          minSpecificity(-1),
+          maxSpecificity(-1)
+    {
+    }
+
+    /**
+     * A confidence score: the sum of the evidence below. Higher is more certain.
+     */
+    int score() const
+    {
+        return neighbors + duplicates + votes;
+    }
+
+public:
+
+    /// The region of the face, in relative coordinates
+    QRectF rect;
+
+    /// The number of raw detections of the primary cascade grouped into this face
+    int    neighbors;
+
+    /// The number of other primary cascades which found the face
+    int    duplicates;
+
+    /// The number of verifying cascades which found the face, all of them scanning it
+    int    votes;
+
+    /// If the face passed the verification
+    bool   verified;
+
+    /// The range of "specificity", in steps of 0.01, with which detectFaces() finds the face, or -1.
+    /// A face found again at a later step of specificity is a separate candidate.
+    double minSpecificity;
+    double maxSpecificity;
+};
+
+// --------------------------------------------------------------------------------------------------
+
 class LIBKFACE_EXPORT FaceDetector
 {
 
@@ -53,7 +111,9 @@ public:
      * those regions of a full image which contain face.
      *
      * This class provides shallow copying
-     * The class is fully reentrant (a single object and its copies are not thread-safe).
+     * The class is thread-safe: a single object and its copies can be shared by
+     * many threads, which then detect faces concurrently with one set of loaded cascades.
+     * Parameters set while detections are running take effect for the next detection.
      * Deferred creation is guaranteed, that means creation of a FaceDetector
      * object is cheap, the expensive creation of the detection backend
      * is performed when detectFaces is called for the first time.
@@ -73,9 +133,89 @@ public:
      * provide the original size of the image as this may be of importance in the detection process.
      *
      * Found faces are returned in relative coordinates.
+     * Thread-safe.
      */
     QList<QRectF> detectFaces(const QImage& image, const QSize& originalSize = QSize());
 
+    /**
+     * Reads the image from filePath and scans it for faces. The image is decoded directly
+     * at the size used for detection, which for JPEG uses the scaled decoding of libjpeg:
+     * much faster and with far less memory than reading the full image and scaling it down.
+     *
+     * Found faces are returned in relative coordinates, which apply to the original image.
+     * Thread-safe.
+     */
+    QList<QRectF> detectFaces(const QString& filePath);
+
+    /**
+     * Scans only the given regions of an image for faces, for example a region drawn by the user
+     * or a known face to confirm. The regions, in relative coordinates, are padded by a quarter of
+     * their size on each side, and faces from a quarter of the region size up to the padded size
+     * are searched. This is much faster than scanning the whole image.
+     *
+     * Found faces are returned in coordinates relative to the whole image.
+     * Thread-safe.
+     */
+    QList<QRectF> detectFaces(const QImage& image, const QList<QRectF>& searchRegions,
+                              const QSize& originalSize = QSize());
+
+    /**
+     * Scans an image for faces once with the current accuracy, and returns the faces found with
+     * any specificity with their scores. filterCandidates() then gives the faces detectFaces()
+     * would report for any specificity, without scanning the image again. For the scores, each face
+     * is verified by all verifying cascades, which costs more than the verification of detectFaces().
+     * Thread-safe.
+     */
+    QList<FaceCandidate> detectFaceCandidates(const QImage& image, const QSize& originalSize = QSize());
+
+    /**
+     * Returns the verified candidates reported with sensitivityVsSpecificity, 0..1, rounded to steps of 0.01,
+     * in relative coordinates.
+     */
+    static QList<QRectF> filterCandidates(const QList<FaceCandidate>& candidates, double sensitivityVsSpecificity);
+
+    /**
+     * Scans all images passed by the provider for faces.
+     * For each entry in the provider, in 1-to-1 mapping and in the same order,
+     * the list of found faces in relative coordinates is returned.
+     *
+     * The images are read from the provider in the calling thread, and then prepared and scanned
+     * concurrently on up to maxThreads threads (0: one per core). At most two images per thread
+     * are held in memory at the same time.
+     */
+    QList<QList<QRectF> > detectFaces(ImageListProvider* const images, int maxThreads = 0);
+    QList<QList<QRectF> > detectFaces(const QList<QImage>& images, int maxThreads = 0);
+
+    /**
+     * Scans a large image in overlapping tiles, for faces too small to be found after the image
+     * is downscaled for detectFaces(). The image is scanned at scale (1.0: full resolution),
+     * one tile of the size recommended for detection at a time, on up to maxThreads threads.
+     * Faces cut by a tile border are found in the neighbor tile, large faces in an additional
+     * scan of the downscaled image; the results are merged.
+     *
+     * At most two tiles per thread are held in memory at the same time. Passing a file path of
+     * a format supporting clipped reading, like JPEG, each tile is decoded separately from file,
+     * which keeps the memory used independent of the image size; as each read decodes the file
+     * from the top down to its tile, the tiles are read one after the other. Other formats, like
+     * PNG or TIFF, are decoded once as a whole.
+     *
+     * Found faces are returned in relative coordinates.
+     */
+    QList<QRectF> detectFacesTiled(const QImage& image, double scale = 1.0, int maxThreads = 0);
+    QList<QRectF> detectFacesTiled(const QString& filePath, double scale = 1.0, int maxThreads = 0);
+
+    /**
+     * Two-stage detection for large images: the small thumbnail of the image is scanned for candidates
+     * with high sensitivity, and then only the regions around the candidates are read from the full
+     * resolution image and scanned for faces. Gives close to full resolution results at little more
+     * than the cost of scanning the thumbnail.
+     *
+     * The full image is either given, or read region by region from filePath, like detectFacesTiled().
+     * Found faces are returned in coordinates relative to the full image.
+     */
+    QList<QRectF> detectFacesCoarseToFine(const QImage& thumbnail, const QImage& fullImage);
+    QList<QRectF> detectFacesCoarseToFine(const QImage& thumbnail, const QString& filePath);
+
     /**
      * Tunes backend parameters.
      * Available parameters:
@@ -86,6 +226,22 @@ public:
      * For both pairs: a = 1-b, you can set either.
      * The first pair changes the ROC curve in a trade for computing time.
      * The second pair moves on a given ROC curve towards more false positives, or more missed faces.
+     *
+     * "primaryCascades", "verifyingCascades": QStringList of cascade file names.
+     * The cascades which scan the image, and which verify the faces found. Empty for the default:
+     * "haarcascade_frontalface_alt2.xml" scans and the other Haar cascades verify.
+     * For a fast profile, set "speed" high and let the LBP cascade "lbpcascade_frontalface.xml",
+     * if installed with OpenCV, scan while the Haar cascades verify.
+     *
+     * "timeBudget": milliseconds per image, float, 0 (default) for none. The detector measures the
+     * time of detectFaces() and adapts the "accuracy" used, up to the one set, to meet the budget
+     * on average; only if that is not enough, faces are no longer verified. The decisions are
+     * returned by parameters() in the read-only entry "timeBudgetStatus": the average "milliseconds",
+     * the "accuracy" used, if "verification" runs, and the resulting "searchIncrement" and "minSize".
+     *
+     * parameters() also returns the read-only entry "cascadeStatistics": a map from the name
+     * of each cascade to a map of its "runs", the verifications "skipped" because the
+     * outcome was already decided, and the "milliseconds" and "pixels" spent scanning.
      */
     void        setParameter(const QString& parameter, const QVariant& value);
     void        setParameters(const QVariantMap& parameters);
@@ -104,6 +260,18 @@ public:
 
 private:
 
+    /// detectFaces() in searchRegions, optionally without verification of the faces found
+    QList<QRectF> detectFaces(const QImage& image, const QList<QRectF>& searchRegions,
+                              const QSize& originalSize, bool verify);
+
+    /// detectFaces() in an 8-bit gray image at full resolution, which is not modified
+    QList<QRectF> detectFaces(const cv::Mat& grayImage);
+
+private:
+
+    friend class SequenceFaceDetector;
+    friend class FacePipeline;
+
     class Private;
     QExplicitlySharedDataPointer<Private> d;
 };
@@ -0,0 +1,264 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Face detection and recognition in one pass over an image.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// OpenCV includes need to show up before Qt includes
+#include "opencvimageutils.h"
+
+// Qt includes
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+
+// Local includes
+
+#include "libkface_debug.h"
+#include "facepipeline.h"
+
+namespace KFaceIface
+{
+
+class FacePipeline::Private
+{
+public:
+
+    Private(const FaceDetector& detector, const RecognitionDatabase& database)
+        : detector(detector),
+          database(database)
+    {
+    }
+
+    /**
+     * The first stage: converts image to gray, and returns the faces found in it.
+     */
+    QList<QRectF> detect(const QImage& image, cv::Mat& grayImage)
+    {
+        try
+        {
+            grayImage = grayMatFromQImage(image);
+        }
+        catch (cv::Exception& e)
+        {
+            qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+            return QList<QRectF>();
+        }
+        catch(...)
+        {
+            qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+            return QList<QRectF>();
+        }
+
+        if (grayImage.empty())
+        {
+            return QList<QRectF>();
+        }
+
+        return detector.detectFaces(grayImage);
+    }
+
+    /**
+     * The second stage: recognizes the faces, reading them from the gray image of the first stage.
+     */
+    QList<RecognizedFace> recognize(const cv::Mat& grayImage, const QList<QRectF>& faces)
+    {
+        QList<RecognizedFace> result;
+
+        if (faces.isEmpty())
+        {
+            return result;
+        }
+
+        const QList<QRect> absoluteFaces = FaceDetector::toAbsoluteRects(faces, QSize(grayImage.cols, grayImage.rows));
+        const QList<Identity> identities = database.recognizeFaces(grayImage, absoluteFaces);
+
+        for (int i = 0 ; i < faces.size() ; ++i)
+        {
+            RecognizedFace face;
+            face.rect     = faces.at(i);
+            face.identity = identities.value(i);
+            result << face;
+        }
+
+        return result;
+    }
+
+public:
+
+    /**
+     * Recognition of the faces of one image of a batch.
+     * Frees a slot of the semaphore when done, to bound the number of images in memory.
+     */
+    class RecognitionTask : public QRunnable
+    {
+    public:
+
+        RecognitionTask(Private* const d, const cv::Mat& grayImage, const QList<QRectF>& faces,
+                        const QSharedPointer<QList<RecognizedFace> >& result, QSemaphore* const freeSlots)
+            : m_d(d),
+              m_grayImage(grayImage),
+              m_faces(faces),
+              m_result(result),
+              m_freeSlots(freeSlots)
+        {
+        }
+
+        void run()
+        {
+            *m_result = m_d->recognize(m_grayImage, m_faces);
+            m_grayImage.release();
+            m_freeSlots->release();
+        }
+
+    private:
+
+        Private* const                             m_d;
+        cv::Mat                                    m_grayImage;
+        QList<QRectF>                              m_faces;
+        QSharedPointer<QList<RecognizedFace> >     m_result;
+        QSemaphore* const                          m_freeSlots;
+    };
+
+    /**
+     * Detection of the faces of one image of a batch.
+     * Passes the gray image on to the recognition stage, if faces were found.
+     */
+    class DetectionTask : public QRunnable
+    {
+    public:
+
+        DetectionTask(Private* const d, const QImage& image, const QSharedPointer<QList<RecognizedFace> >& result,
+                      QThreadPool* const recognitionPool, QSemaphore* const freeSlots)
+            : m_d(d),
+              m_image(image),
+              m_result(result),
+              m_recognitionPool(recognitionPool),
+              m_freeSlots(freeSlots)
+        {
+        }
+
+        void run()
+        {
+            cv::Mat grayImage;
+            const QList<QRectF> faces = m_d->detect(m_image, grayImage);
+            m_image                   = QImage();
+
+            if (faces.isEmpty())
+            {
+                m_freeSlots->release();
+                return;
+            }
+
+            m_recognitionPool->start(new RecognitionTask(m_d, grayImage, faces, m_result, m_freeSlots));
+        }
+
+    private:
+
+        Private* const                             m_d;
+        QImage                                     m_image;
+        QSharedPointer<QList<RecognizedFace> >     m_result;
+        QThreadPool* const                         m_recognitionPool;
+        QSemaphore* const                          m_freeSlots;
+    };
+
+public:
+
+    FaceDetector        detector;
+    RecognitionDatabase database;
+};
+
+FacePipeline::FacePipeline(const FaceDetector& detector, const RecognitionDatabase& database)
+    : d(new Private(detector, database))
+{
+}
+
+FacePipeline::~FacePipeline()
+{
+    delete d;
+}
+
+QList<RecognizedFace> FacePipeline::process(const QImage& image)
+{
+    cv::Mat grayImage;
+    const QList<QRectF> faces = d->detect(image, grayImage);
+
+    return d->recognize(grayImage, faces);
+}
+
+QList<QList<RecognizedFace> > FacePipeline::process(ImageListProvider* const images, int maxThreads)
+{
+    QList<QList<RecognizedFace> > result;
+
+    if (!images)
+    {
+        return result;
+    }
+
+    const int threads = maxThreads > 0 ? maxThreads : qMax(1, QThread::idealThreadCount());
+
+    // The stages share the threads, detection being the more expensive one
+    const int detectionThreads   = qMax(1, (threads + 1) / 2);
+    const int recognitionThreads = qMax(1, threads - detectionThreads);
+
+    QThreadPool detectionPool;
+    detectionPool.setMaxThreadCount(detectionThreads);
+    QThreadPool recognitionPool;
+    recognitionPool.setMaxThreadCount(recognitionThreads);
+
+    // Taken when an image is read, freed when it left the last stage
+    QSemaphore freeSlots(2 * threads);
+    QList<QSharedPointer<QList<RecognizedFace> > > pending;
+
+    for ( ; !images->atEnd() ; images->proceed())
+    {
+        freeSlots.acquire();
+
+        QSharedPointer<QList<RecognizedFace> > faces(new QList<RecognizedFace>);
+        pending << faces;
+        detectionPool.start(new Private::DetectionTask(d, images->image(), faces, &recognitionPool, &freeSlots));
+    }
+
+    // All recognition tasks are started once the detection is done
+    detectionPool.waitForDone();
+    recognitionPool.waitForDone();
+
+    foreach (const QSharedPointer<QList<RecognizedFace> >& faces, pending)
+    {
+        result << *faces;
+    }
+
+    return result;
+}
+
+QList<QList<RecognizedFace> > FacePipeline::process(const QList<QImage>& images, int maxThreads)
+{
+    QListImageListProvider provider(images);
+
+    return process(&provider, maxThreads);
+}
+
+} // namespace KFaceIface
@@ -0,0 +1,108 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Face detection and recognition in one pass over an image.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_FACEPIPELINE_H
+#define KFACE_FACEPIPELINE_H
+
+// Qt includes
+
+#include <QImage>
+#include <QList>
+#include <QRectF>
+
+// Local includes
+
+#include "libkface_export.h"
+#include "dataproviders.h"
+#include "facedetector.h"
+#include "identity.h"
+#include "recognitiondatabase.h"
+
+namespace KFaceIface
+{
+
+/**
+ * A face found by FacePipeline, and who it is.
+ */
+class RecognizedFace
+{
+public:
+
+    /// The region of the face, in relative coordinates
+    QRectF   rect;
+
+    /// The recognized identity, or the null identity
+    Identity identity;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+class LIBKFACE_EXPORT FacePipeline
+{
+
+public:
+
+    /**
+     * Detects the faces in images with detector, and recognizes them with database.
+     *
+     * Each image is converted to gray once, at full resolution. The detection scans a downscaled copy
+     * of the gray image, and the recognition reads the faces as regions of it, without cutting and
+     * converting each face from the color image again.
+     *
+     * The class is thread-safe, as are the detector and the database it uses.
+     */
+    FacePipeline(const FaceDetector& detector, const RecognitionDatabase& database);
+    ~FacePipeline();
+
+    /**
+     * Returns the faces in image with their identities.
+     */
+    QList<RecognizedFace> process(const QImage& image);
+
+    /**
+     * Processes all images passed by the provider, returning the faces of each in the same order.
+     *
+     * The images are read from the provider in the calling thread. Detection and recognition are
+     * two stages on separate thread pools which share maxThreads threads (0: one per core), at least
+     * one each: while the faces of one image are recognized, the next images are scanned.
+     * Within a stage, the detection and large recognition galleries additionally use
+     * OpenCV's own worker threads. At most two images per thread are held in memory at the same time.
+     */
+    QList<QList<RecognizedFace> > process(ImageListProvider* const images, int maxThreads = 0);
+    QList<QList<RecognizedFace> > process(const QList<QImage>& images, int maxThreads = 0);
+
+private:
+
+    FacePipeline(const FacePipeline&);
+    FacePipeline& operator=(const FacePipeline&);
+
+    class Private;
+    Private* const d;
+};
+
+} // namespace KFaceIface
+
+#endif // KFACE_FACEPIPELINE_H
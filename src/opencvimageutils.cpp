@@ -0,0 +1,129 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Conversion of QImage to OpenCV gray scale images.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "opencvimageutils.h"
+
+// Qt includes
+
+#include <QVector>
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+/// A read-only header on the pixel data of image. constBits() does not detach the image.
+cv::Mat wrapQImage(const QImage& image, int type)
+{
+    return cv::Mat(image.height(), image.width(), type, const_cast<uchar*>(image.constBits()), image.bytesPerLine());
+}
+
+/// Nearest neighbor scaling of a header to size, or the header itself.
+cv::Mat sampled(const cv::Mat& wrapper, const cv::Size& size)
+{
+    if (wrapper.size() == size)
+    {
+        return wrapper;
+    }
+
+    cv::Mat result;
+    cv::resize(wrapper, result, size, 0, 0, cv::INTER_NEAREST);
+    return result;
+}
+
+/// Gray values of the color table entries, converted like the RGB888 pixels they stand for.
+cv::Mat grayColorTable(const QImage& image)
+{
+    const QVector<QRgb> colors = image.colorTable();
+    cv::Mat             table  = cv::Mat::zeros(1, 256, CV_8UC3);
+
+    for (int i = 0 ; i < qMin(colors.size(), 256) ; ++i)
+    {
+        uchar* const rgb = table.ptr<uchar>() + 3 * i;
+        rgb[0]           = qRed(colors.at(i));
+        rgb[1]           = qGreen(colors.at(i));
+        rgb[2]           = qBlue(colors.at(i));
+    }
+
+    cv::Mat gray;
+    cv::cvtColor(table, gray, CV_RGB2GRAY);
+    return gray;
+}
+
+} // namespace
+
+cv::Mat grayMatFromQImage(const QImage& image, const QSize& size)
+{
+    if (image.isNull())
+    {
+        return cv::Mat();
+    }
+
+    const cv::Size targetSize = size.isValid() ? cv::Size(size.width(), size.height())
+                                               : cv::Size(image.width(), image.height());
+    cv::Mat        gray;
+
+    switch (image.format())
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            // I think we can ignore premultiplication when converting to grayscale
+            cv::cvtColor(sampled(wrapQImage(image, CV_8UC4), targetSize), gray, CV_RGBA2GRAY);
+            break;
+        case QImage::Format_RGB888:
+            cv::cvtColor(sampled(wrapQImage(image, CV_8UC3), targetSize), gray, CV_RGB2GRAY);
+            break;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+        case QImage::Format_Grayscale8:
+            // the only copy of the data, so that the result can be modified in place
+            gray = sampled(wrapQImage(image, CV_8UC1), targetSize).clone();
+            break;
+#endif
+        case QImage::Format_Indexed8:
+            cv::LUT(sampled(wrapQImage(image, CV_8UC1), targetSize), grayColorTable(image), gray);
+            break;
+        default:
+        {
+            // Other formats need a conversion by Qt. Scale first, then convert only the remaining pixels.
+            QImage converted = image;
+
+            if (image.size() != QSize(targetSize.width, targetSize.height))
+            {
+                converted = converted.scaled(targetSize.width, targetSize.height, Qt::IgnoreAspectRatio);
+            }
+
+            converted = converted.convertToFormat(QImage::Format_RGB888);
+            cv::cvtColor(wrapQImage(converted, CV_8UC3), gray, CV_RGB2GRAY);
+            break;
+        }
+    }
+
+    return gray;
+}
+
+} // namespace KFaceIface
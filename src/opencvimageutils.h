@@ -0,0 +1,55 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Conversion of QImage to OpenCV gray scale images.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_OPENCVIMAGEUTILS_H
+#define KFACE_OPENCVIMAGEUTILS_H
+
+// OpenCV library
+
+#include "libopencv.h"
+
+// Qt includes
+
+#include <QImage>
+#include <QSize>
+
+namespace KFaceIface
+{
+
+/**
+ * Returns an 8-bit, single channel gray scale copy of image, scaled to size
+ * with nearest neighbor sampling if size is valid and differs from the image size.
+ *
+ * The pixel data of image is read in place: 32 bit RGB, RGB888, Grayscale8 and
+ * Indexed8 images are neither detached nor converted to another QImage format.
+ * When scaling, only the sampled pixels are converted to gray.
+ * The returned matrix owns its data and can be modified in place.
+ */
+cv::Mat grayMatFromQImage(const QImage& image, const QSize& size = QSize());
+
+} // namespace KFaceIface
+
+#endif // KFACE_OPENCVIMAGEUTILS_H
@@ -48,6 +48,8 @@
 // Local includes
 
 #include "libkface_debug.h"
+#include "histogramdistance.h"
+#include "lbphistogram.h"
 
 using namespace cv;
 
@@ -274,6 +276,145 @@ static Mat elbp(InputArray src, int radius, int neighbors)
     return dst;
 }
 
+//------------------------------------------------------------------------------
+// spatial histogram of the extended local binary patterns of an image
+//------------------------------------------------------------------------------
+
+static Mat lbp_spatial_histogram(const Mat& src, int radius, int neighbors, int grid_x, int grid_y)
+{
+    int numPatterns = static_cast<int>(std::pow(2.0, static_cast<double>(neighbors)));
+
+    if(src.type() != CV_8UC1)
+    {
+        return spatial_histogram(elbp(src, radius, neighbors), numPatterns, grid_x, grid_y, true);
+    }
+
+    // 8-bit grayscale faces take the fused path, which does not create the LBP image
+    Mat result(1, grid_x * grid_y * numPatterns, CV_32FC1);
+    lbpSpatialHistogram(src.ptr<uchar>(), src.step, src.rows, src.cols, radius, neighbors, grid_x, grid_y, result.ptr<float>());
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Chi-square distance between the stored sample at the given gallery row and the
+// query histogram. Equivalent to compareHist(sample, query, CV_COMP_CHISQR), but
+// uses the vectorized kernel directly on the gallery rows.
+//------------------------------------------------------------------------------
+
+static inline double sampleDistance(const Mat& histograms, int sampleIdx, const Mat& query)
+{
+    if (query.type() == CV_32FC1 && query.isContinuous() && (int)query.total() == histograms.cols)
+    {
+        return chiSquareDistance(histograms.ptr<float>(sampleIdx), query.ptr<float>(), histograms.cols);
+    }
+
+    return compareHist(histograms.row(sampleIdx), query, CV_COMP_CHISQR);
+}
+
+//------------------------------------------------------------------------------
+// Parallel gallery scan: the gallery rows are split into chunks of nearly
+// equal size, one per concurrent stripe of cv::parallel_for_.
+//------------------------------------------------------------------------------
+
+static inline Range chunkRows(int chunk, int chunks, int rows)
+{
+    return Range((int)((int64)rows * chunk / chunks), (int)((int64)rows * (chunk + 1) / chunks));
+}
+
+namespace
+{
+
+class SampleDistancesScan : public ParallelLoopBody
+{
+public:
+
+    SampleDistancesScan(const Mat& histograms, const Mat& query, int chunks, double* const distances)
+        : m_histograms(histograms),
+          m_query(query),
+          m_chunks(chunks),
+          m_distances(distances)
+    {
+    }
+
+    void operator()(const Range& range) const
+    {
+        for(int chunk = range.start; chunk < range.end; chunk++)
+        {
+            const Range rows = chunkRows(chunk, m_chunks, m_histograms.rows);
+
+            for(int sampleIdx = rows.start; sampleIdx < rows.end; sampleIdx++)
+            {
+                m_distances[sampleIdx] = sampleDistance(m_histograms, sampleIdx, m_query);
+            }
+        }
+    }
+
+private:
+
+    const Mat&    m_histograms;
+    const Mat&    m_query;
+    const int     m_chunks;
+    double* const m_distances;
+};
+
+struct NearestSample
+{
+    NearestSample()
+        : sampleIdx(-1),
+          distance(DBL_MAX)
+    {
+    }
+
+    int    sampleIdx;
+    double distance;
+};
+
+class NearestSampleScan : public ParallelLoopBody
+{
+public:
+
+    NearestSampleScan(const Mat& histograms, const Mat& query, int chunks, double threshold, NearestSample* const results)
+        : m_histograms(histograms),
+          m_query(query),
+          m_chunks(chunks),
+          m_threshold(threshold),
+          m_results(results)
+    {
+    }
+
+    void operator()(const Range& range) const
+    {
+        for(int chunk = range.start; chunk < range.end; chunk++)
+        {
+            const Range rows = chunkRows(chunk, m_chunks, m_histograms.rows);
+            NearestSample nearest;
+
+            for(int sampleIdx = rows.start; sampleIdx < rows.end; sampleIdx++)
+            {
+                double dist = sampleDistance(m_histograms, sampleIdx, m_query);
+
+                if((dist < nearest.distance) && (dist < m_threshold))
+                {
+                    nearest.distance  = dist;
+                    nearest.sampleIdx = sampleIdx;
+                }
+            }
+
+            m_results[chunk] = nearest;
+        }
+    }
+
+private:
+
+    const Mat&           m_histograms;
+    const Mat&           m_query;
+    const int            m_chunks;
+    const double         m_threshold;
+    NearestSample* const m_results;
+};
+
+} // namespace
+
 /*
  * Implementation not copied from OpenCV
 void LBPHFaceRecognizer::load(const FileStorage& fs)
@@ -351,7 +492,7 @@ void LBPHFaceRecognizer::train(InputArrayOfArrays _in_src, InputArray _inm_label
     if(!preserveData)
     {
         m_labels.release();
-        m_histograms.clear();
+        m_histograms.release();
     }
 
     // append labels to m_labels matrix
@@ -363,20 +504,113 @@ void LBPHFaceRecognizer::train(InputArrayOfArrays _in_src, InputArray _inm_label
     // store the spatial histograms of the original data
     for(size_t sampleIdx = 0; sampleIdx < src.size(); sampleIdx++)
     {
-        // calculate lbp image
-        Mat lbp_image = elbp(src[sampleIdx], m_radius, m_neighbors);
-        // get spatial histogram from this lbp image
-        Mat p = spatial_histogram(lbp_image,                                                         /* lbp_image                   */
-                                  static_cast<int>(std::pow(2.0, static_cast<double>(m_neighbors))), /* number of possible patterns */
-                                  m_grid_x,                                                          /* grid size x                 */
-                                  m_grid_y,                                                          /* grid size y                 */
-                                  true
-                                 );
-        // add to templates
+        // get spatial histogram of the lbp image
+        Mat p = lbp_spatial_histogram(src[sampleIdx], m_radius, m_neighbors, m_grid_x, m_grid_y);
+        // add to templates, the gallery matrix grows geometrically
         m_histograms.push_back(p);
     }
 }
 
+void LBPHFaceRecognizer::appendHistograms(const Mat& histograms, const Mat& labels)
+{
+    if(histograms.empty())
+        return;
+
+    if(histograms.type() != CV_32FC1 || (size_t)histograms.rows != labels.total() || labels.type() != CV_32SC1)
+    {
+        String error_message = format("Expected one CV_32FC1 histogram row per CV_32SC1 label. Was %d rows of type %d, %d labels of type %d.",
+                                      histograms.rows, histograms.type(), (int)labels.total(), labels.type());
+        CV_Error(CV_StsBadArg, error_message);
+    }
+
+    if(m_histograms.empty())
+    {
+        m_histograms = histograms.isContinuous() ? histograms : histograms.clone();
+    }
+    else
+    {
+        if(histograms.cols != m_histograms.cols)
+        {
+            String error_message = format("Histogram length %d does not match the gallery histogram length %d.", histograms.cols, m_histograms.cols);
+            CV_Error(CV_StsBadArg, error_message);
+        }
+
+        m_histograms.push_back(histograms);
+    }
+
+    m_labels.push_back(labels.reshape(1, (int)labels.total()));
+}
+
+void LBPHFaceRecognizer::detachHistograms(int additionalRows)
+{
+    if(m_histograms.empty())
+        return;
+
+    const int rows = m_histograms.rows;
+    Mat histograms(rows + std::max(additionalRows, 0), m_histograms.cols, m_histograms.type());
+    Mat target = histograms.rowRange(0, rows);
+    m_histograms.copyTo(target);
+
+    // Shrinking keeps the capacity of the buffer for the rows to be appended
+    histograms.resize(rows);
+    m_histograms = histograms;
+
+    m_labels = m_labels.clone();
+}
+
+int LBPHFaceRecognizer::scanChunks() const
+{
+    if(m_histograms.rows < m_parallelScanThreshold)
+        return 1;
+
+    int threads = (m_parallelScanThreads > 0) ? m_parallelScanThreads : getNumThreads();
+
+    return std::max(1, std::min(threads, m_histograms.rows));
+}
+
+void LBPHFaceRecognizer::sampleDistances(const Mat& query, std::vector<double>& distances) const
+{
+    distances.resize(m_histograms.rows);
+
+    if(distances.empty())
+        return;
+
+    const int chunks = scanChunks();
+    SampleDistancesScan scan(m_histograms, query, chunks, &distances[0]);
+
+    if(chunks > 1)
+        parallel_for_(Range(0, chunks), scan, chunks);
+    else
+        scan(Range(0, 1));
+}
+
+int LBPHFaceRecognizer::nearestSample(const Mat& query, double threshold, double& distance) const
+{
+    const int chunks = scanChunks();
+    std::vector<NearestSample> results(chunks);
+    NearestSampleScan scan(m_histograms, query, chunks, threshold, &results[0]);
+
+    if(chunks > 1)
+        parallel_for_(Range(0, chunks), scan, chunks);
+    else
+        scan(Range(0, 1));
+
+    // Reduce in chunk order, so that the first of equally near samples wins, as in a serial scan
+    NearestSample nearest;
+
+    for(size_t chunk = 0; chunk < results.size(); chunk++)
+    {
+        if(results[chunk].sampleIdx != -1 && results[chunk].distance < nearest.distance)
+        {
+            nearest = results[chunk];
+        }
+    }
+
+    distance = nearest.distance;
+
+    return nearest.sampleIdx;
+}
+
 #if OPENCV_TEST_VERSION(3,1,0)
 void LBPHFaceRecognizer::predict(InputArray _src, int &minClass, double &minDist) const
 #else
@@ -393,18 +627,12 @@ void LBPHFaceRecognizer::predict(cv::InputArray _src, cv::Ptr<cv::face::PredictC
     Mat src = _src.getMat();
 
     // get the spatial histogram from input image
-    Mat lbp_image = elbp(src, m_radius, m_neighbors);
-    Mat query     = spatial_histogram(lbp_image,                                                         /* lbp_image                   */
-                                      static_cast<int>(std::pow(2.0, static_cast<double>(m_neighbors))), /* number of possible patterns */
-                                      m_grid_x,                                                          /* grid size x                 */
-                                      m_grid_y,                                                          /* grid size y                 */
-                                      true                                                               /* normed histograms           */
-                                     );
+    Mat query = lbp_spatial_histogram(src, m_radius, m_neighbors, m_grid_x, m_grid_y);
 #if OPENCV_TEST_VERSION(3,1,0)
     minDist      = DBL_MAX;
     minClass     = -1;
 #else
-    collector->init((int)m_histograms.size(), state);
+    collector->init(m_histograms.rows, state);
 #endif
 
     // This is the standard method
@@ -412,24 +640,26 @@ void LBPHFaceRecognizer::predict(cv::InputArray _src, cv::Ptr<cv::face::PredictC
     if (m_statisticsMode == NearestNeighbor)
     {
         // find 1-nearest neighbor
-        for(size_t sampleIdx = 0; sampleIdx < m_histograms.size(); sampleIdx++)
-        {
-            double dist = compareHist(m_histograms[sampleIdx], query, CV_COMP_CHISQR);
-
 #if OPENCV_TEST_VERSION(3,1,0)
-            if((dist < minDist) && (dist < m_threshold))
-            {
-                minDist  = dist;
-                minClass = m_labels.at<int>((int) sampleIdx);
-            }
+        int sampleIdx = nearestSample(query, m_threshold, minDist);
+
+        if(sampleIdx != -1)
+        {
+            minClass = m_labels.at<int>(sampleIdx);
+        }
 #else
-            int label = m_labels.at<int>((int) sampleIdx);
-            if (!collector->emit(label, dist, state))
+        std::vector<double> distances;
+        sampleDistances(query, distances);
+
+        for(int sampleIdx = 0; sampleIdx < m_histograms.rows; sampleIdx++)
+        {
+            int label = m_labels.at<int>(sampleIdx);
+            if (!collector->emit(label, distances[sampleIdx], state))
             {
                 return;
             }
-#endif
         }
+#endif
     }
 
     // All other methods are just unvalidated examples.
@@ -439,11 +669,13 @@ void LBPHFaceRecognizer::predict(cv::InputArray _src, cv::Ptr<cv::face::PredictC
     {
         // Create map "label -> vector of distances to all histograms for this label"
         std::map<int, std::vector<int> > distancesMap;
+        std::vector<double> sampleDists;
+        sampleDistances(query, sampleDists);
 
-        for(size_t sampleIdx = 0; sampleIdx < m_histograms.size(); sampleIdx++)
+        for(int sampleIdx = 0; sampleIdx < m_histograms.rows; sampleIdx++)
         {
-            double dist                 = compareHist(m_histograms[sampleIdx], query, CV_COMP_CHISQR);
-            std::vector<int>& distances = distancesMap[m_labels.at<int>((int) sampleIdx)];
+            double dist                 = sampleDists[sampleIdx];
+            std::vector<int>& distances = distancesMap[m_labels.at<int>(sampleIdx)];
             distances.push_back(dist);
         }
 
@@ -486,11 +718,13 @@ void LBPHFaceRecognizer::predict(cv::InputArray _src, cv::Ptr<cv::face::PredictC
 
         // map "label -> number of histograms"
         std::map<int, int> countMap;
+        std::vector<double> sampleDists;
+        sampleDistances(query, sampleDists);
 
-        for(size_t sampleIdx = 0; sampleIdx < m_histograms.size(); sampleIdx++)
+        for(int sampleIdx = 0; sampleIdx < m_histograms.rows; sampleIdx++)
         {
-            int label   = m_labels.at<int>((int) sampleIdx);
-            double dist = compareHist(m_histograms[sampleIdx], query, CV_COMP_CHISQR);
+            int label   = m_labels.at<int>(sampleIdx);
+            double dist = sampleDists[sampleIdx];
             distancesMap.insert(std::pair<double, int>(dist, label));
             countMap[label]++;
         }
@@ -76,7 +76,9 @@ public:
         m_radius(radius_),
         m_neighbors(neighbors_),
         m_threshold(threshold),
-        m_statisticsMode(statistics)
+        m_statisticsMode(statistics),
+        m_parallelScanThreshold(1024),
+        m_parallelScanThreads(0)
     {
     }
 
@@ -96,7 +98,9 @@ public:
         m_radius(radius_),
         m_neighbors(neighbors_),
         m_threshold(threshold),
-        m_statisticsMode(statistics)
+        m_statisticsMode(statistics),
+        m_parallelScanThreshold(1024),
+        m_parallelScanThreads(0)
     {
         train(src, labels);
     }
@@ -184,8 +188,8 @@ public:
     double getThreshold() const                          { return m_threshold;            }
     void setThreshold(double _threshold)                 { m_threshold = _threshold;      }
 
-    void setHistograms(std::vector<cv::Mat> _histograms) { m_histograms = _histograms;    }
-    std::vector<cv::Mat> getHistograms() const           { return m_histograms;           }
+    void setHistograms(const cv::Mat& _histograms)       { m_histograms = _histograms;    }
+    cv::Mat getHistograms() const                        { return m_histograms;           }
 
     void setLabels(cv::Mat _labels)                      { m_labels = _labels;            }
     cv::Mat getLabels() const                            { return m_labels;               }
@@ -195,6 +199,42 @@ public:
 
 #endif
 
+    /**
+     * Read-only access to the gallery, without a copy and without going through cv::Algorithm.
+     * The references stay valid until the model is trained, updated or appended to.
+     */
+    const cv::Mat& histograms() const                    { return m_histograms;            }
+    const cv::Mat& labels()     const                    { return m_labels;                }
+
+    /**
+     * Appends samples to the gallery: one CV_32FC1 histogram per row,
+     * and a CV_32SC1 label per sample. If the gallery is empty, the given
+     * matrix is taken over without copying.
+     */
+    void appendHistograms(const cv::Mat& histograms, const cv::Mat& labels);
+
+    /**
+     * Moves the gallery to a new buffer of its own, with room for additionalRows more histograms.
+     * Appending to a gallery writes into the spare capacity of its buffer without regard to
+     * other matrices sharing it: call this first if the buffer may be shared with another model.
+     */
+    void detachHistograms(int additionalRows);
+
+    /**
+     * The gallery scan in predict() is split over several threads
+     * if the gallery holds at least minimumSamples histograms.
+     * threads is the number of concurrent chunks; 0 uses cv::getNumThreads(),
+     * 1 disables the parallel scan.
+     */
+    void setParallelScan(int minimumSamples, int threads)
+    {
+        m_parallelScanThreshold = minimumSamples;
+        m_parallelScanThreads   = threads;
+    }
+
+    int parallelScanThreshold() const                    { return m_parallelScanThreshold; }
+    int parallelScanThreads()   const                    { return m_parallelScanThreads;   }
+
 private:
 
     /** Computes a LBPH model with images in src and
@@ -203,6 +243,18 @@ private:
      */
     void train(cv::InputArrayOfArrays src, cv::InputArray labels, bool preserveData);
 
+    /** Returns the number of chunks the gallery scan is split into, 1 for a serial scan.
+     */
+    int scanChunks() const;
+
+    /** Computes the distances of all gallery samples to the query histogram.
+     */
+    void sampleDistances(const cv::Mat& query, std::vector<double>& distances) const;
+
+    /** Returns the gallery row with the smallest distance below threshold, or -1.
+     */
+    int nearestSample(const cv::Mat& query, double threshold, double& distance) const;
+
 private:
 
     // NOTE: Do not use a d private internal container, this will crash OpenCV in cv::Algorithm::set()
@@ -213,8 +265,13 @@ private:
     double               m_threshold;
     int                  m_statisticsMode;
 
-    std::vector<cv::Mat> m_histograms;
+    /// The gallery: one continuous, row-major matrix of CV_32FC1 with one spatial histogram per row.
+    /// m_labels holds the label of each row (CV_32SC1, one column).
+    cv::Mat              m_histograms;
     cv::Mat              m_labels;
+
+    int                  m_parallelScanThreshold;
+    int                  m_parallelScanThreads;
 };
 
 } // namespace KFaceIface
@@ -0,0 +1,197 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Vectorized histogram distances for LBPH recognition.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "histogramdistance.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// The vectorized kernels are compiled with per-function target attributes,
+// so the library itself can still be built for the baseline architecture.
+#if (defined(__x86_64__) || defined(__i386__)) &&                                                                   \
+    ((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) ||              \
+     (!defined(__clang__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#   define KFACE_HISTOGRAM_X86_DISPATCH
+#   include <immintrin.h>
+#endif
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+/// Same cut-off as cv::compareHist, which compares the double value of h1 with DBL_EPSILON.
+/// 2^-52 is exactly representable as a float.
+const float histogramEpsilon = static_cast<float>(DBL_EPSILON);
+
+enum
+{
+    /// Number of bins summed up in float precision before adding to the double result.
+    /// This is the size of one LBP cell histogram.
+    BlockLength = 256
+};
+
+typedef double (*ChiSquareFunction)(const float* const, const float* const, int);
+
+double chiSquareScalar(const float* const h1, const float* const h2, int length)
+{
+    double result = 0;
+
+    for (int i = 0 ; i < length ; ++i)
+    {
+        double a = h1[i] - h2[i];
+        double b = h1[i];
+
+        if (std::fabs(b) > DBL_EPSILON)
+        {
+            result += a*a / b;
+        }
+    }
+
+    return result;
+}
+
+#ifdef KFACE_HISTOGRAM_X86_DISPATCH
+
+__attribute__((target("sse2")))
+double chiSquareSse2(const float* const h1, const float* const h2, int length)
+{
+    const __m128 absMask   = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 epsilon   = _mm_set1_ps(histogramEpsilon);
+    const int    vectorEnd = length & ~3;
+    double       result    = 0;
+    int          i         = 0;
+
+    while (i < vectorEnd)
+    {
+        const int blockEnd = std::min(vectorEnd, i + (int)BlockLength);
+        __m128    sum      = _mm_setzero_ps();
+
+        for ( ; i < blockEnd ; i += 4)
+        {
+            const __m128 b    = _mm_loadu_ps(h1 + i);
+            const __m128 a    = _mm_sub_ps(b, _mm_loadu_ps(h2 + i));
+            const __m128 mask = _mm_cmpgt_ps(_mm_and_ps(b, absMask), epsilon);
+            // Division by an empty bin gives inf or nan, which is masked out.
+            const __m128 q    = _mm_div_ps(_mm_mul_ps(a, a), b);
+            sum               = _mm_add_ps(sum, _mm_and_ps(mask, q));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, sum);
+        result += (double(lanes[0]) + double(lanes[1])) + (double(lanes[2]) + double(lanes[3]));
+    }
+
+    return result + chiSquareScalar(h1 + vectorEnd, h2 + vectorEnd, length - vectorEnd);
+}
+
+__attribute__((target("avx")))
+double chiSquareAvx(const float* const h1, const float* const h2, int length)
+{
+    const __m256 absMask   = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 epsilon   = _mm256_set1_ps(histogramEpsilon);
+    const int    vectorEnd = length & ~7;
+    double       result    = 0;
+    int          i         = 0;
+
+    while (i < vectorEnd)
+    {
+        const int blockEnd = std::min(vectorEnd, i + (int)BlockLength);
+        __m256    sum      = _mm256_setzero_ps();
+
+        for ( ; i < blockEnd ; i += 8)
+        {
+            const __m256 b    = _mm256_loadu_ps(h1 + i);
+            const __m256 a    = _mm256_sub_ps(b, _mm256_loadu_ps(h2 + i));
+            const __m256 mask = _mm256_cmp_ps(_mm256_and_ps(b, absMask), epsilon, _CMP_GT_OQ);
+            const __m256 q    = _mm256_div_ps(_mm256_mul_ps(a, a), b);
+            sum               = _mm256_add_ps(sum, _mm256_and_ps(mask, q));
+        }
+
+        float lanes[8];
+        _mm256_storeu_ps(lanes, sum);
+        result += ((double(lanes[0]) + double(lanes[1])) + (double(lanes[2]) + double(lanes[3]))) +
+                  ((double(lanes[4]) + double(lanes[5])) + (double(lanes[6]) + double(lanes[7])));
+    }
+
+    return result + chiSquareScalar(h1 + vectorEnd, h2 + vectorEnd, length - vectorEnd);
+}
+
+#endif // KFACE_HISTOGRAM_X86_DISPATCH
+
+class ChiSquareDispatch
+{
+public:
+
+    ChiSquareDispatch()
+        : function(&chiSquareScalar),
+          name("scalar")
+    {
+#ifdef KFACE_HISTOGRAM_X86_DISPATCH
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx"))
+        {
+            function = &chiSquareAvx;
+            name     = "avx";
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            function = &chiSquareSse2;
+            name     = "sse2";
+        }
+#endif
+    }
+
+public:
+
+    ChiSquareFunction function;
+    const char*       name;
+};
+
+const ChiSquareDispatch& chiSquareDispatch()
+{
+    static const ChiSquareDispatch dispatch;
+    return dispatch;
+}
+
+} // namespace
+
+double chiSquareDistance(const float* const h1, const float* const h2, int length)
+{
+    return chiSquareDispatch().function(h1, h2, length);
+}
+
+const char* chiSquareDistanceImplementation()
+{
+    return chiSquareDispatch().name;
+}
+
+} // namespace KFaceIface
@@ -0,0 +1,52 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Vectorized histogram distances for LBPH recognition.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_HISTOGRAMDISTANCE_H
+#define KFACE_HISTOGRAMDISTANCE_H
+
+namespace KFaceIface
+{
+
+/**
+ * Chi-square distance between two float histograms of the given length,
+ * with the same definition as cv::compareHist(h1, h2, CV_COMP_CHISQR):
+ * sum over all bins of (h1 - h2)^2 / h1, skipping empty bins of h1.
+ *
+ * The implementation is selected once at runtime from the instruction sets
+ * supported by the CPU (AVX, SSE2, or a portable scalar loop).
+ * Both arrays need no particular alignment.
+ */
+double chiSquareDistance(const float* const h1, const float* const h2, int length);
+
+/**
+ * Returns the name of the implementation chosen by chiSquareDistance(),
+ * one of "avx", "sse2" or "scalar".
+ */
+const char* chiSquareDistanceImplementation();
+
+} // namespace KFaceIface
+
+#endif // KFACE_HISTOGRAMDISTANCE_H
@@ -55,7 +55,9 @@ LBPHistogramMetadata::~LBPHistogramMetadata()
 
 LBPHFaceModel::LBPHFaceModel()
     : cv::Ptr<LBPHFaceRecognizer>(LBPHFaceRecognizer::create()),
-      databaseId(0)
+      databaseId(0),
+      m_firstUnsavedHistogram(0),
+      m_sharedGallery(false)
 {
 #if OPENCV_TEST_VERSION(3,0,0)
     ptr()->set("threshold", 100.0);
@@ -68,6 +70,27 @@ LBPHFaceModel::~LBPHFaceModel()
 {
 }
 
+LBPHFaceModel LBPHFaceModel::copy() const
+{
+    LBPHFaceModel model;
+    model.setRadius(radius());
+    model.setNeighbors(neighbors());
+    model.setGridX(gridX());
+    model.setGridY(gridY());
+    model.ptr()->setParallelScan(ptr()->parallelScanThreshold(), ptr()->parallelScanThreads());
+
+    // Takes over the gallery matrix without copying, only the labels are copied.
+    // Both models share the buffer now, see detachGallery().
+    model.ptr()->appendHistograms(ptr()->histograms(), ptr()->labels());
+
+    model.databaseId              = databaseId;
+    model.m_histogramMetadata     = m_histogramMetadata;
+    model.m_firstUnsavedHistogram = m_firstUnsavedHistogram;
+    model.m_sharedGallery         = true;
+
+    return model;
+}
+
 LBPHFaceRecognizer* LBPHFaceModel::ptr()
 {
     LBPHFaceRecognizer* const ptr = cv::Ptr<LBPHFaceRecognizer>::operator KFaceIface::LBPHFaceRecognizer*();
@@ -166,11 +189,8 @@ void LBPHFaceModel::setGridY(int grid_y)
 
 OpenCVMatData LBPHFaceModel::histogramData(int index) const
 {
-#if OPENCV_TEST_VERSION(3,0,0)
-    return OpenCVMatData(ptr()->get<std::vector<cv::Mat> >("histograms").at(index));
-#else
-    return OpenCVMatData(ptr()->getHistograms().at(index));
-#endif
+    // OpenCVMatData refers to the row of the gallery matrix without copying it
+    return OpenCVMatData(ptr()->histograms().row(index));
 }
 
 QList<LBPHistogramMetadata> LBPHFaceModel::histogramMetadata() const
@@ -178,10 +198,31 @@ QList<LBPHistogramMetadata> LBPHFaceModel::histogramMetadata() const
     return m_histogramMetadata;
 }
 
+int LBPHFaceModel::histogramCount() const
+{
+    return m_histogramMetadata.size();
+}
+
+const LBPHistogramMetadata& LBPHFaceModel::histogramMetadata(int index) const
+{
+    return m_histogramMetadata.at(index);
+}
+
+int LBPHFaceModel::firstUnsavedHistogram() const
+{
+    return m_firstUnsavedHistogram;
+}
+
 void LBPHFaceModel::setWrittenToDatabase(int index, int id)
 {
     m_histogramMetadata[index].databaseId    = id;
     m_histogramMetadata[index].storageStatus = LBPHistogramMetadata::InDatabase;
+
+    while (m_firstUnsavedHistogram < m_histogramMetadata.size() &&
+           m_histogramMetadata.at(m_firstUnsavedHistogram).storageStatus == LBPHistogramMetadata::InDatabase)
+    {
+        m_firstUnsavedHistogram++;
+    }
 }
 
 void LBPHFaceModel::setHistograms(const QList<OpenCVMatData>& histograms, const QList<LBPHistogramMetadata>& histogramMetadata)
@@ -190,42 +231,59 @@ void LBPHFaceModel::setHistograms(const QList<OpenCVMatData>& histograms, const
      * Does not work with standard OpenCV, as these two params are declared read-only in OpenCV.
      * One reason why we copied the code.
      */
-    std::vector<cv::Mat> newHistograms;
-    cv::Mat newLabels;
-    newHistograms.reserve(histograms.size());
-    newLabels.reserve(histogramMetadata.size());
+    m_histogramMetadata.clear();
+    m_firstUnsavedHistogram = 0;
 
-    foreach (const OpenCVMatData& histogram, histograms)
+    const int count = qMin(histograms.size(), histogramMetadata.size());
+
+    detachGallery(count);
+
+    if (count == 0)
     {
-        newHistograms.push_back(histogram.toMat());
+        return;
     }
 
-    m_histogramMetadata.clear();
+    // The gallery is one continuous matrix: copy the stored data directly into its rows.
+    const int length = histograms.first().rows * histograms.first().cols;
+    cv::Mat newHistograms(count, length, CV_32FC1);
+    cv::Mat newLabels(count, 1, CV_32SC1);
+    int row          = 0;
 
-    foreach (const LBPHistogramMetadata& metadata, histogramMetadata)
+    for (int i = 0 ; i < count ; i++)
     {
-        newLabels.push_back(metadata.identity);
-        m_histogramMetadata << metadata;
+        const OpenCVMatData& histogram = histograms.at(i);
+        const cv::Mat data(histogram.rows, histogram.cols, histogram.type, (void*)histogram.data.constData());
+
+        if (histogram.rows * histogram.cols != length || CV_MAT_CN(histogram.type) != 1 ||
+            (size_t)histogram.data.size() < data.total() * data.elemSize())
+        {
+            qCWarning(LIBKFACE_LOG) << "Skipping histogram of size [" << histogram.rows << ", " << histogram.cols
+                                    << "] and type " << histogram.type << " for identity " << histogramMetadata.at(i).identity;
+            continue;
+        }
+
+        if (histogram.type == CV_32FC1)
+        {
+            memcpy(newHistograms.ptr(row), data.data, length * sizeof(float));
+        }
+        else
+        {
+            cv::Mat destination = newHistograms.row(row);
+            data.reshape(1, 1).convertTo(destination, CV_32F);
+        }
+
+        newLabels.at<int>(row) = histogramMetadata.at(i).identity;
+        m_histogramMetadata << histogramMetadata.at(i);
+        row++;
     }
 
-#if OPENCV_TEST_VERSION(3,0,0)
-    std::vector<cv::Mat> currentHistograms = ptr()->get<std::vector<cv::Mat> >("histograms");
-    cv::Mat currentLabels                  = ptr()->get<cv::Mat>("labels");
-#else
-    std::vector<cv::Mat> currentHistograms = ptr()->getHistograms();
-    cv::Mat currentLabels                  = ptr()->getLabels();
-#endif
-
-    currentHistograms.insert(currentHistograms.end(), newHistograms.begin(), newHistograms.end());
-    currentLabels.push_back(newLabels);
+    ptr()->appendHistograms(newHistograms.rowRange(0, row), newLabels.rowRange(0, row));
 
-#if OPENCV_TEST_VERSION(3,0,0)
-    ptr()->set("histograms", currentHistograms);
-    ptr()->set("labels",     currentLabels);
-#else
-    ptr()->setHistograms(currentHistograms);
-    ptr()->setLabels(currentLabels);
-#endif
+    while (m_firstUnsavedHistogram < m_histogramMetadata.size() &&
+           m_histogramMetadata.at(m_firstUnsavedHistogram).storageStatus == LBPHistogramMetadata::InDatabase)
+    {
+        m_firstUnsavedHistogram++;
+    }
 
 /*
     //Most cumbersome and inefficient way through a file storage which we were forced to use if we used standard OpenCV
@@ -261,17 +319,24 @@ void LBPHFaceModel::setHistograms(const QList<OpenCVMatData>& histograms, const
 */
 }
 
+void LBPHFaceModel::detachGallery(int additionalRows)
+{
+    // Appending writes behind the rows of the matrix, into memory the model this one was copied from may use
+    if (m_sharedGallery)
+    {
+        ptr()->detachHistograms(additionalRows);
+        m_sharedGallery = false;
+    }
+}
+
 void LBPHFaceModel::update(const std::vector<cv::Mat>& images, const std::vector<int>& labels, const QString& context)
 {
+    detachGallery((int)images.size());
     ptr()->update(images, labels);
 
     // Update local information
     // We assume new labels are simply appended
-#if OPENCV_TEST_VERSION(3,0,0)
-    cv::Mat currentLabels = ptr()->get<cv::Mat>("labels");
-#else
-    cv::Mat currentLabels = ptr()->getLabels();
-#endif
+    const cv::Mat& currentLabels = ptr()->labels();
 
     for (int i = m_histogramMetadata.size() ; i < currentLabels.rows ; i++)
     {
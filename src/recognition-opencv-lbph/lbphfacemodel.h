@@ -80,6 +80,14 @@ public:
     LBPHFaceModel();
     ~LBPHFaceModel();
 
+    /**
+     * Returns a separate model with the parameters, histograms and metadata of this one,
+     * for example to train a new version while this one is still used for recognition.
+     * Copying is cheap, the gallery is shared until either model is changed: the changed
+     * model first moves its gallery to a buffer of its own.
+     */
+    LBPHFaceModel copy() const;
+
     LBPHFaceRecognizer*       ptr();
     const LBPHFaceRecognizer* ptr() const;
 
@@ -96,8 +104,17 @@ public:
     void setGridY(int grid_y);
 
     QList<LBPHistogramMetadata> histogramMetadata() const;
+
+    /// Number of histograms in the model, and the metadata of one of them, without copying the list
+    int                         histogramCount() const;
+    const LBPHistogramMetadata& histogramMetadata(int index) const;
+
+    /// Returns the histogram at index. The data is not copied but shared with the model,
+    /// so it must not be used after the model has been updated.
     OpenCVMatData               histogramData(int index) const;
 
+    /// All histograms before this index are stored in the database; histogramCount() if all are.
+    int  firstUnsavedHistogram() const;
     void setWrittenToDatabase(int index, int databaseId);
 
     void setHistograms(const QList<OpenCVMatData>& histograms, const QList<LBPHistogramMetadata>& histogramMetadata);
@@ -109,9 +126,18 @@ public:
 
     int databaseId;
 
+protected:
+
+    /// Moves the gallery to a buffer of its own before appending additionalRows, if it is shared
+    void detachGallery(int additionalRows);
+
 protected:
 
     QList<LBPHistogramMetadata> m_histogramMetadata;
+    int                         m_firstUnsavedHistogram;
+
+    /// If the gallery buffer is shared with the model this one was copied from
+    bool                        m_sharedGallery;
 };
 
 } // namespace KFaceIface
@@ -0,0 +1,374 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Fused extended local binary patterns and spatial histogram computation.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "lbphistogram.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// See histogramdistance.cpp
+#if (defined(__x86_64__) || defined(__i386__)) &&                                                                   \
+    ((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) ||              \
+     (!defined(__clang__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#   define KFACE_LBP_X86_DISPATCH
+#   include <immintrin.h>
+#endif
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+/**
+ * A sample point on the circle around the center pixel, with its bilinear
+ * interpolation weights. Computed with exactly the same expressions as in elbp_(),
+ * so that the fused kernel gives bit-identical patterns.
+ */
+class LBPSamplePoint
+{
+public:
+
+    LBPSamplePoint(int radius, int n, int neighbors, ptrdiff_t step)
+    {
+        const double pi = 3.1415926535897932384626433832795; // CV_PI
+
+        // sample points
+        float x   = static_cast<float>(radius * std::cos(2.0*pi*n/static_cast<float>(neighbors)));
+        float y   = static_cast<float>(-radius * std::sin(2.0*pi*n/static_cast<float>(neighbors)));
+
+        // relative indices
+        fx        = static_cast<int>(std::floor(x));
+        fy        = static_cast<int>(std::floor(y));
+        cx        = static_cast<int>(std::ceil(x));
+        cy        = static_cast<int>(std::ceil(y));
+
+        // fractional part
+        float ty  = y - fy;
+        float tx  = x - fx;
+
+        // set interpolation weights
+        w1        = (1 - tx) * (1 - ty);
+        w2        =      tx  * (1 - ty);
+        w3        = (1 - tx) *      ty;
+        w4        =      tx  *      ty;
+
+        offset1   = fy * step + fx;
+        offset2   = fy * step + cx;
+        offset3   = cy * step + fx;
+        offset4   = cy * step + cx;
+    }
+
+    /// Returns the bit of this sample point for the center pixel p, as in elbp_()
+    inline int bit(const unsigned char* const p) const
+    {
+        const float center = *p;
+        // calculate interpolated value
+        float t            = static_cast<float>(w1*p[offset1] + w2*p[offset2] + w3*p[offset3] + w4*p[offset4]);
+        // floating point precision, so check some machine-dependent epsilon
+        return (t > center) || (std::abs(t - center) < std::numeric_limits<float>::epsilon());
+    }
+
+public:
+
+    int       fx, fy, cx, cy;
+    float     w1, w2, w3, w4;
+    ptrdiff_t offset1, offset2, offset3, offset4;
+};
+
+typedef std::vector<LBPSamplePoint> LBPSamplePoints;
+
+/**
+ * Any radius and number of neighbors: codes of count pixels, starting at the center pixel row.
+ */
+void lbpCodesGeneric(const unsigned char* const row, const LBPSamplePoints& points, int count, int* const codes)
+{
+    const int neighbors = (int)points.size();
+
+    for (int x = 0 ; x < count ; ++x)
+    {
+        const unsigned char* const p = row + x;
+        int code                     = 0;
+
+        for (int n = 0 ; n < neighbors ; ++n)
+        {
+            code += points[n].bit(p) << n;
+        }
+
+        codes[x] = code;
+    }
+}
+
+/**
+ * radius=1, neighbors=8: the four axis neighbors fall exactly on pixels,
+ * and the interpolation in elbp_() reduces to an integer comparison.
+ * Only the diagonals need the interpolated value.
+ */
+void lbpCodes8Scalar(const unsigned char* const row, ptrdiff_t step, const LBPSamplePoints& points,
+                     int start, int count, unsigned char* const codes)
+{
+    for (int x = start ; x < count ; ++x)
+    {
+        const unsigned char* const p = row + x;
+        const unsigned char        c = *p;
+
+        int code = (p[1]     >= c)       |
+                   ((p[-step] >= c) << 2) |
+                   ((p[-1]    >= c) << 4) |
+                   ((p[step]  >= c) << 6);
+
+        code    |= (points[1].bit(p) << 1) |
+                   (points[3].bit(p) << 3) |
+                   (points[5].bit(p) << 5) |
+                   (points[7].bit(p) << 7);
+
+        codes[x] = (unsigned char)code;
+    }
+}
+
+#ifdef KFACE_LBP_X86_DISPATCH
+
+__attribute__((target("sse2")))
+inline void toFloat(__m128i v, __m128* const f)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo   = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi   = _mm_unpackhi_epi8(v, zero);
+    f[0]               = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+    f[1]               = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+    f[2]               = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+    f[3]               = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+}
+
+/// Unsigned byte comparison a >= b, as 0xFF / 0x00 per byte
+__attribute__((target("sse2")))
+inline __m128i greaterOrEqual(__m128i a, __m128i b)
+{
+    return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+
+/**
+ * Vectorized variant of lbpCodes8Scalar(), 16 pixels at a time.
+ * Returns the number of pixels processed.
+ */
+__attribute__((target("sse2")))
+int lbpCodes8Sse2(const unsigned char* const row, ptrdiff_t step, const LBPSamplePoints& points,
+                  int count, unsigned char* const codes)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+
+    // For the diagonals, the weights and the index of their pixel in the 3x3 neighborhood
+    __m128 weights[4][4];
+    int    pixels[4][4];
+
+    for (int d = 0 ; d < 4 ; ++d)
+    {
+        const LBPSamplePoint& s = points[2*d + 1];
+        weights[d][0]           = _mm_set1_ps(s.w1);
+        weights[d][1]           = _mm_set1_ps(s.w2);
+        weights[d][2]           = _mm_set1_ps(s.w3);
+        weights[d][3]           = _mm_set1_ps(s.w4);
+        pixels[d][0]            = (s.fy + 1) * 3 + (s.fx + 1);
+        pixels[d][1]            = (s.fy + 1) * 3 + (s.cx + 1);
+        pixels[d][2]            = (s.cy + 1) * 3 + (s.fx + 1);
+        pixels[d][3]            = (s.cy + 1) * 3 + (s.cx + 1);
+    }
+
+    int x = 0;
+
+    for ( ; x + 16 <= count ; x += 16)
+    {
+        const unsigned char* const p = row + x;
+        __m128i v[9];
+
+        for (int dy = -1 ; dy <= 1 ; ++dy)
+        {
+            for (int dx = -1 ; dx <= 1 ; ++dx)
+            {
+                v[(dy + 1) * 3 + (dx + 1)] = _mm_loadu_si128((const __m128i*)(p + dy * step + dx));
+            }
+        }
+
+        const __m128i c = v[4];
+
+        // Axis neighbors: right, top, left, bottom
+        __m128i code    = _mm_and_si128(greaterOrEqual(v[5], c), _mm_set1_epi8(1 << 0));
+        code            = _mm_or_si128(code, _mm_and_si128(greaterOrEqual(v[1], c), _mm_set1_epi8(1 << 2)));
+        code            = _mm_or_si128(code, _mm_and_si128(greaterOrEqual(v[3], c), _mm_set1_epi8(1 << 4)));
+        code            = _mm_or_si128(code, _mm_and_si128(greaterOrEqual(v[7], c), _mm_set1_epi8(1 << 6)));
+
+        // Diagonals, interpolated in float with the same order of operations as elbp_()
+        __m128 f[9][4];
+
+        for (int k = 0 ; k < 9 ; ++k)
+        {
+            toFloat(v[k], f[k]);
+        }
+
+        for (int d = 0 ; d < 4 ; ++d)
+        {
+            __m128i mask[4];
+
+            for (int q = 0 ; q < 4 ; ++q)
+            {
+                __m128 t = _mm_mul_ps(weights[d][0], f[pixels[d][0]][q]);
+                t        = _mm_add_ps(t, _mm_mul_ps(weights[d][1], f[pixels[d][1]][q]));
+                t        = _mm_add_ps(t, _mm_mul_ps(weights[d][2], f[pixels[d][2]][q]));
+                t        = _mm_add_ps(t, _mm_mul_ps(weights[d][3], f[pixels[d][3]][q]));
+
+                const __m128 center = f[4][q];
+                const __m128 equal  = _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(t, center), absMask), epsilon);
+                mask[q]             = _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(t, center), equal));
+            }
+
+            const __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(mask[0], mask[1]),
+                                                  _mm_packs_epi32(mask[2], mask[3]));
+            code                = _mm_or_si128(code, _mm_and_si128(bytes, _mm_set1_epi8(static_cast<char>(1 << (2*d + 1)))));
+        }
+
+        _mm_storeu_si128((__m128i*)(codes + x), code);
+    }
+
+    return x;
+}
+
+bool hasSse2()
+{
+    static const bool sse2 = (__builtin_cpu_init(), __builtin_cpu_supports("sse2"));
+    return sse2;
+}
+
+#endif // KFACE_LBP_X86_DISPATCH
+
+void lbpCodes8(const unsigned char* const row, ptrdiff_t step, const LBPSamplePoints& points,
+               int count, unsigned char* const codes)
+{
+    int start = 0;
+
+#ifdef KFACE_LBP_X86_DISPATCH
+    if (hasSse2())
+    {
+        start = lbpCodes8Sse2(row, step, points, count, codes);
+    }
+#endif
+
+    lbpCodes8Scalar(row, step, points, start, count, codes);
+}
+
+/// Adds the codes of one row of the LBP image to the histograms of a row of cells.
+template <typename T>
+inline void accumulateCodes(const T* const codes, int gridX, int cellWidth, int numPatterns, int* const counts)
+{
+    for (int cellX = 0 ; cellX < gridX ; ++cellX)
+    {
+        int* const     cellCounts = counts + cellX * numPatterns;
+        const T* const cellCodes  = codes  + cellX * cellWidth;
+
+        for (int x = 0 ; x < cellWidth ; ++x)
+        {
+            cellCounts[cellCodes[x]]++;
+        }
+    }
+}
+
+} // namespace
+
+void lbpSpatialHistogram(const unsigned char* const data, size_t step, int rows, int cols,
+                         int radius, int neighbors, int gridX, int gridY,
+                         float* const histogram)
+{
+    const int numPatterns = 1 << neighbors;
+    const int lbpRows     = rows - 2 * radius;
+    const int lbpCols     = cols - 2 * radius;
+
+    std::fill(histogram, histogram + (size_t)gridX * gridY * numPatterns, 0.0f);
+
+    if (lbpRows <= 0 || lbpCols <= 0 || gridX <= 0 || gridY <= 0)
+    {
+        return;
+    }
+
+    // calculate LBP patch size. Patterns right and below the last full cell are not used.
+    const int cellWidth  = lbpCols / gridX;
+    const int cellHeight = lbpRows / gridY;
+    const int usedCols   = cellWidth * gridX;
+
+    if (cellWidth == 0 || cellHeight == 0)
+    {
+        return;
+    }
+
+    // normalization as in histc_(), which divides the float histogram by the cell area
+    const int   cellArea      = cellWidth * cellHeight;
+    const bool  specialized   = (radius == 1 && neighbors == 8);
+    LBPSamplePoints points;
+
+    for (int n = 0 ; n < neighbors ; ++n)
+    {
+        points.push_back(LBPSamplePoint(radius, n, neighbors, (ptrdiff_t)step));
+    }
+
+    std::vector<int>           counts((size_t)gridX * numPatterns);
+    std::vector<int>           codes(specialized ? 0 : usedCols);
+    std::vector<unsigned char> codes8(specialized ? usedCols : 0);
+
+    for (int cellY = 0 ; cellY < gridY ; ++cellY)
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+
+        for (int y = cellY * cellHeight ; y < (cellY + 1) * cellHeight ; ++y)
+        {
+            // first center pixel of this row of the LBP image
+            const unsigned char* const row = data + (size_t)(y + radius) * step + radius;
+
+            if (specialized)
+            {
+                lbpCodes8(row, (ptrdiff_t)step, points, usedCols, &codes8[0]);
+                accumulateCodes(&codes8[0], gridX, cellWidth, numPatterns, &counts[0]);
+            }
+            else
+            {
+                lbpCodesGeneric(row, points, usedCols, &codes[0]);
+                accumulateCodes(&codes[0], gridX, cellWidth, numPatterns, &counts[0]);
+            }
+        }
+
+        float* const cellRowHistogram = histogram + (size_t)cellY * gridX * numPatterns;
+
+        for (size_t i = 0 ; i < counts.size() ; ++i)
+        {
+            cellRowHistogram[i] = static_cast<float>(counts[i]) / cellArea;
+        }
+    }
+}
+
+} // namespace KFaceIface
@@ -0,0 +1,56 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Fused extended local binary patterns and spatial histogram computation.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_LBPHISTOGRAM_H
+#define KFACE_LBPHISTOGRAM_H
+
+// C++ includes
+
+#include <cstddef>
+
+namespace KFaceIface
+{
+
+/**
+ * Computes the normalized spatial histogram of the extended local binary patterns
+ * of an 8-bit single channel image in a single pass, without creating the LBP image.
+ *
+ * The patterns and counts are identical to computing the LBP image with elbp() and passing it
+ * to spatial_histogram() in facerec_borrowed.cpp: the LBP image, which is smaller
+ * than the input by radius on each side, is divided into gridX x gridY cells,
+ * and each cell contributes a histogram of 2^neighbors bins. Each bin is divided
+ * by the cell area, as histc_() does.
+ *
+ * histogram must hold gridX * gridY * 2^neighbors floats; cells are stored row by row.
+ * The default configuration radius=1, neighbors=8 uses a specialized, vectorized path.
+ */
+void lbpSpatialHistogram(const unsigned char* const data, size_t step, int rows, int cols,
+                         int radius, int neighbors, int gridX, int gridY,
+                         float* const histogram);
+
+} // namespace KFaceIface
+
+#endif // KFACE_LBPHISTOGRAM_H
@@ -29,11 +29,18 @@
 
 #include "opencvlbphfacerecognizer.h"
 
+// Qt includes
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+
 // local includes
 
 #include "libkface_debug.h"
 #include "databasefaceaccess.h"
 #include "libopencv.h"
+#include "opencvimageutils.h"
 #include "lbphfacemodel.h"
 #include "trainingdb.h"
 
@@ -47,32 +54,84 @@ public:
     Private(DatabaseFaceAccessData* const db)
         : db(db),
           threshold(100),
-          loaded(false)
+          parallelScanThreshold(1024),
+          parallelScanThreads(0)
     {
     }
 
 public:
 
-    LBPHFaceModel& lbph()
+    /**
+     * Returns the current version of the model, loading it on first use.
+     * The snapshot is never changed: a recognition keeps using it until finished,
+     * even if a new version is published meanwhile.
+     */
+    QSharedPointer<const LBPHFaceModel> snapshot()
     {
-        if (!loaded)
+        QMutexLocker lock(&snapshotMutex);
+
+        if (!current)
         {
-            m_lbph = DatabaseFaceAccess(db).db()->lbphFaceModel();
-            loaded = true;
+            LBPHFaceModel model = DatabaseFaceAccess(db).db()->lbphFaceModel();
+            model.ptr()->setParallelScan(parallelScanThreshold, parallelScanThreads);
+            current = QSharedPointer<const LBPHFaceModel>(new LBPHFaceModel(model));
         }
 
-        return m_lbph;
+        return current;
+    }
+
+    /**
+     * Makes model the current version. Recognitions started afterwards use it.
+     */
+    void publish(LBPHFaceModel model)
+    {
+        QMutexLocker lock(&snapshotMutex);
+        model.ptr()->setParallelScan(parallelScanThreshold, parallelScanThreads);
+        current = QSharedPointer<const LBPHFaceModel>(new LBPHFaceModel(model));
+    }
+
+    void setParallelScanThreshold(int minimumSamples)
+    {
+        QMutexLocker lock(&snapshotMutex);
+        parallelScanThreshold = minimumSamples;
+        applyScanParameters();
+    }
+
+    void setParallelScanThreads(int threads)
+    {
+        QMutexLocker lock(&snapshotMutex);
+        parallelScanThreads = threads;
+        applyScanParameters();
+    }
+
+private:
+
+    /// Call with snapshotMutex locked
+    void applyScanParameters()
+    {
+        if (current)
+        {
+            // The current snapshot is shared with running recognitions, replace it by a copy
+            LBPHFaceModel model = current->copy();
+            model.ptr()->setParallelScan(parallelScanThreshold, parallelScanThreads);
+            current = QSharedPointer<const LBPHFaceModel>(new LBPHFaceModel(model));
+        }
     }
 
 public:
 
     DatabaseFaceAccessData* db;
-    float               threshold;
+    float                   threshold;
+
+    /// Serializes training and clearing, which each build a new version of the model
+    QMutex                  updateMutex;
 
 private:
 
-    LBPHFaceModel       m_lbph;
-    bool                loaded;
+    QMutex                              snapshotMutex;
+    QSharedPointer<const LBPHFaceModel> current;
+    int                                 parallelScanThreshold;
+    int                                 parallelScanThreads;
 };
 
 OpenCVLBPHFaceRecognizer::OpenCVLBPHFaceRecognizer(DatabaseFaceAccessData* const db)
@@ -99,6 +158,16 @@ void OpenCVLBPHFaceRecognizer::setThreshold(float threshold) const
     d->threshold    = min + factor*(max-min);
 }
 
+void OpenCVLBPHFaceRecognizer::setParallelScanThreshold(int minimumSamples)
+{
+    d->setParallelScanThreshold(qMax(0, minimumSamples));
+}
+
+void OpenCVLBPHFaceRecognizer::setParallelScanThreads(int threads)
+{
+    d->setParallelScanThreads(qMax(0, threads));
+}
+
 namespace
 {
     enum
@@ -109,41 +178,57 @@ namespace
 
 cv::Mat OpenCVLBPHFaceRecognizer::prepareForRecognition(const QImage& inputImage)
 {
-    QImage image(inputImage);
+    QSize size = inputImage.size();
 
     if (inputImage.width() > TargetInputSize || inputImage.height() > TargetInputSize)
     {
-        image = inputImage.scaled(TargetInputSize, TargetInputSize, Qt::IgnoreAspectRatio);
+        size = QSize(TargetInputSize, TargetInputSize);
     }
 
-    cv::Mat cvImage = cv::Mat(image.height(), image.width(), CV_8UC1);
-    cv::Mat cvImageWrapper;
-
-    switch (image.format())
-    {
-        case QImage::Format_RGB32:
-        case QImage::Format_ARGB32:
-        case QImage::Format_ARGB32_Premultiplied:
-            // I think we can ignore premultiplication when converting to grayscale
-            cvImageWrapper = cv::Mat(image.height(), image.width(), CV_8UC4, image.scanLine(0), image.bytesPerLine());
-            cvtColor(cvImageWrapper, cvImage, CV_RGBA2GRAY);
-            break;
-        default:
-            image          = image.convertToFormat(QImage::Format_RGB888);
-            cvImageWrapper = cv::Mat(image.height(), image.width(), CV_8UC3, image.scanLine(0), image.bytesPerLine());
-            cvtColor(cvImageWrapper, cvImage, CV_RGB2GRAY);
-            break;
+    // Reads the pixels of inputImage in place, scaling and gray conversion in one step
+    cv::Mat cvImage = grayMatFromQImage(inputImage, size);
+
+    if (cvImage.empty())
+    {
+        return cvImage;
     }
 
     equalizeHist(cvImage, cvImage);
     return cvImage;
 }
 
+cv::Mat OpenCVLBPHFaceRecognizer::prepareForRecognition(const cv::Mat& grayImage)
+{
+    cv::Mat cvImage;
+
+    if (grayImage.empty())
+    {
+        return cvImage;
+    }
+
+    if (grayImage.cols > TargetInputSize || grayImage.rows > TargetInputSize)
+    {
+        // Nearest neighbor sampling, as for a QImage
+        cv::resize(grayImage, cvImage, cv::Size(TargetInputSize, TargetInputSize), 0, 0, cv::INTER_NEAREST);
+        equalizeHist(cvImage, cvImage);
+    }
+    else
+    {
+        // Writes to a new matrix, grayImage may be a region of a larger image
+        equalizeHist(grayImage, cvImage);
+    }
+
+    return cvImage;
+}
+
 int OpenCVLBPHFaceRecognizer::recognize(const cv::Mat& inputImage)
 {
     int predictedLabel = -1;
     double confidence  = 0;
-    d->lbph()->predict(inputImage, predictedLabel, confidence);
+
+    // Stays valid while a training publishes a new version
+    const QSharedPointer<const LBPHFaceModel> model = d->snapshot();
+    model->ptr()->predict(inputImage, predictedLabel, confidence);
     qCDebug(LIBKFACE_LOG) << predictedLabel << confidence;
 
     if (confidence > d->threshold)
@@ -161,9 +246,32 @@ void OpenCVLBPHFaceRecognizer::train(const std::vector<cv::Mat>& images, const s
         return;
     }
 
-    d->lbph().update(images, labels, context);
+    QMutexLocker lock(&d->updateMutex);
+
+    // The new version is built aside, recognitions continue with the current one
+    LBPHFaceModel model = d->snapshot()->copy();
+    model.update(images, labels, context);
     // add to database
-    DatabaseFaceAccess(d->db).db()->updateLBPHFaceModel(d->lbph());
+    DatabaseFaceAccess(d->db).db()->updateLBPHFaceModel(model);
+
+    d->publish(model);
+}
+
+void OpenCVLBPHFaceRecognizer::clearTraining(const QList<int>& identities, const QString& context)
+{
+    QMutexLocker lock(&d->updateMutex);
+
+    if (identities.isEmpty())
+    {
+        DatabaseFaceAccess(d->db).db()->clearLBPHTraining(context);
+    }
+    else
+    {
+        DatabaseFaceAccess(d->db).db()->clearLBPHTraining(identities, context);
+    }
+
+    // The new version is the remaining training, reloaded
+    d->publish(DatabaseFaceAccess(d->db).db()->lbphFaceModel());
 }
 
 } // namespace KFaceIface
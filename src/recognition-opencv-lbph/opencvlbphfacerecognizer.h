@@ -37,6 +37,7 @@
 // Qt include
 
 #include <QImage>
+#include <QList>
 
 // local includes
 
@@ -61,22 +62,46 @@ public:
     void setThreshold(float threshold) const;
 
     /**
-     *  Returns a cvMat created from the inputImage, optimized for recognition
+     *  Configures the parallel gallery scan during recognition:
+     *  galleries of at least minimumSamples histograms are scanned by the given number of threads.
+     *  A value of 0 for threads uses the OpenCV default, 1 disables the parallel scan.
      */
-    cv::Mat prepareForRecognition(const QImage& inputImage);
+    void setParallelScanThreshold(int minimumSamples);
+    void setParallelScanThreads(int threads);
+
+    /**
+     *  Returns a cvMat created from the inputImage, optimized for recognition.
+     *  Independent of any instance, can be called concurrently.
+     */
+    static cv::Mat prepareForRecognition(const QImage& inputImage);
+
+    /**
+     *  Same as above for an 8-bit gray image, which can be a region of a larger image and is not modified
+     */
+    static cv::Mat prepareForRecognition(const cv::Mat& grayImage);
 
     /**
      *  Try to recognize the given image.
      *  Returns the identity id.
      *  If the identity cannot be recognized, returns -1.
+     *  Several threads may recognize at the same time, also while training: each recognition
+     *  uses the model current when it starts, and a model published meanwhile applies to the next one.
      */
     int recognize(const cv::Mat& inputImage);
 
     /**
      *  Trains the given images, representing faces of the given matched identities.
+     *  The trained model is a new version, which replaces the current one when complete:
+     *  recognitions are not blocked meanwhile.
      */
     void train(const std::vector<cv::Mat>& images, const std::vector<int>& labels, const QString& context);
 
+    /**
+     *  Removes the training of the given identities, or all training if empty, in the given context.
+     *  As for train(), the model without this training replaces the current one when complete.
+     */
+    void clearTraining(const QList<int>& identities, const QString& context);
+
 private:
 
     class Private;
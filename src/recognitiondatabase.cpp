@@ -35,7 +35,10 @@
 
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadLocker>
+#include <QReadWriteLock>
 #include <QSharedData>
+#include <QWriteLocker>
 #include <QUuid>
 #include <QDir>
 #include <QStandardPaths>
@@ -49,6 +52,8 @@
 #include "databasefaceoperationgroup.h"
 #include "databasefaceparameters.h"
 #include "dataproviders.h"
+#include "facedetector.h"
+#include "opencvimageutils.h"
 #include "trainingdb.h"
 
 namespace KFaceIface
@@ -136,7 +141,13 @@ public:
     bool                    dbAvailable;
 
     const QString           configPath;
-    QMutex                  mutex;
+
+    /**
+     * Shared by recognition and identity lookups, exclusive for identity changes and parameters.
+     * Preprocessing of images runs without it. Training and clearing do not need it,
+     * the recognizer publishes a new version of its model when done.
+     */
+    QReadWriteLock          readWriteLock;
     DatabaseFaceAccessData* db;
 
     QVariantMap             parameters;
@@ -159,7 +170,23 @@ public:
 
     // Change these three lines to change CurrentRecognizer
     typedef OpenCVLBPHFaceRecognizer CurrentRecognizer;
-    CurrentRecognizer* recognizer()             { return getObjectOrCreate(opencvlbph); }
+
+    /// Call with readWriteLock locked, as the parameters are applied on creation.
+    /// Concurrent readers may create the recognizer, which is then kept until destruction.
+    CurrentRecognizer* recognizer()
+    {
+        QMutexLocker lock(&recognizerMutex);
+
+        if (!opencvlbph)
+        {
+            // The recognizer is created on first use, and takes the current parameters
+            getObjectOrCreate(opencvlbph);
+            applyParameters();
+        }
+
+        return opencvlbph;
+    }
+
     CurrentRecognizer* recognizerConst()  const { return opencvlbph;                    }
 
     OpenCVLBPHFaceRecognizer* lbph()            { return getObjectOrCreate(opencvlbph); }
@@ -173,11 +200,13 @@ public:
 
 public:
 
-    void train(OpenCVLBPHFaceRecognizer* const r, const QList<Identity>& identitiesToBeTrained,
+    void train(const QList<Identity>& identitiesToBeTrained,
                TrainingDataProvider* const data, const QString& trainingContext);
-    void clear(OpenCVLBPHFaceRecognizer* const, const QList<int>& idsToClear, const QString& trainingContext);
+    void clear(const QList<int>& idsToClear, const QString& trainingContext);
 
-    cv::Mat preprocessingChain(const QImage& image);
+    /// Independent of the state of the database, called without lock
+    static cv::Mat preprocessingChain(const QImage& image);
+    static cv::Mat preprocessingChain(const cv::Mat& grayImage);
 
 public:
 
@@ -193,6 +222,7 @@ private:
 
 private:
 
+    QMutex                    recognizerMutex;
     OpenCVLBPHFaceRecognizer* opencvlbph;
     FunnelReal*               funnel;
 };
@@ -241,7 +271,6 @@ void RecognitionDatabaseStaticPriv::removeDatabase(const QString& key)
 
 RecognitionDatabase::Private::Private(const QString& configPath)
     : configPath(configPath),
-      mutex(QMutex::Recursive),
       db(DatabaseFaceAccess::create()),
       opencvlbph(0),
       funnel(0)
@@ -324,7 +353,7 @@ QList<Identity> RecognitionDatabase::allIdentities() const
     if (!d || !d->dbAvailable)
         return QList<Identity>();
 
-    QMutexLocker lock(&d->mutex);
+    QReadLocker lock(&d->readWriteLock);
 
     return (d->identityCache.values());
 }
@@ -336,7 +365,7 @@ Identity RecognitionDatabase::identity(int id) const
         return Identity();
     }
 
-    QMutexLocker lock(&d->mutex);
+    QReadLocker lock(&d->readWriteLock);
 
     return (d->identityCache.value(id));
 }
@@ -397,7 +426,7 @@ Identity RecognitionDatabase::findIdentity(const QString& attribute, const QStri
         return Identity();
     }
 
-    QMutexLocker lock(&d->mutex);
+    QReadLocker lock(&d->readWriteLock);
 
     return (d->findByAttribute(attribute, value));
 }
@@ -409,7 +438,7 @@ Identity RecognitionDatabase::findIdentity(const QMap<QString, QString>& attribu
         return Identity();
     }
 
-    QMutexLocker lock(&d->mutex);
+    QReadLocker lock(&d->readWriteLock);
 
     Identity match;
 
@@ -473,11 +502,11 @@ Identity RecognitionDatabase::addIdentity(const QMap<QString, QString>& attribut
         return Identity();
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
 
     if (attributes.contains(QString::fromLatin1("uuid")))
     {
-        Identity matchByUuid = findIdentity(QString::fromLatin1("uuid"), attributes.value(QString::fromLatin1("uuid")));
+        Identity matchByUuid = d->findByAttribute(QString::fromLatin1("uuid"), attributes.value(QString::fromLatin1("uuid")));
 
         if (!matchByUuid.isNull())
         {
@@ -512,7 +541,7 @@ void RecognitionDatabase::addIdentityAttributes(int id, const QMap<QString, QStr
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
 
     QHash<int, Identity>::iterator it = d->identityCache.find(id);
 
@@ -532,7 +561,7 @@ void RecognitionDatabase::addIdentityAttribute(int id, const QString& attribute,
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
     QHash<int, Identity>::iterator it = d->identityCache.find(id);
 
     if (it != d->identityCache.end())
@@ -551,7 +580,7 @@ void RecognitionDatabase::setIdentityAttributes(int id, const QMap<QString, QStr
             return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
     QHash<int, Identity>::iterator it = d->identityCache.find(id);
 
     if (it != d->identityCache.end())
@@ -568,13 +597,23 @@ QString RecognitionDatabase::backendIdentifier() const
 
 void RecognitionDatabase::Private::applyParameters()
 {
-    if (recognizerConst())
+    CurrentRecognizer* const r = recognizerConst();
+
+    if (r)
     {
         for (QVariantMap::const_iterator it = parameters.constBegin(); it != parameters.constEnd(); ++it)
         {
             if (it.key() == QString::fromLatin1("threshold") || it.key() == QString::fromLatin1("accuracy"))
             {
-                recognizer()->setThreshold(it.value().toFloat());
+                r->setThreshold(it.value().toFloat());
+            }
+            else if (it.key() == QString::fromLatin1("parallelScanThreshold"))
+            {
+                r->setParallelScanThreshold(it.value().toInt());
+            }
+            else if (it.key() == QString::fromLatin1("parallelScanThreads"))
+            {
+                r->setParallelScanThreads(it.value().toInt());
             }
         }
     }
@@ -587,7 +626,7 @@ void RecognitionDatabase::setParameter(const QString& parameter, const QVariant&
             return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
 
     d->parameters.insert(parameter, value);
     d->applyParameters();
@@ -600,7 +639,7 @@ void RecognitionDatabase::setParameters(const QVariantMap& parameters)
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
 
     for (QVariantMap::const_iterator it = parameters.begin(); it != parameters.end(); ++it)
     {
@@ -617,7 +656,7 @@ QVariantMap RecognitionDatabase::parameters() const
         return QVariantMap();
     }
 
-    QMutexLocker lock(&d->mutex);
+    QReadLocker lock(&d->readWriteLock);
 
     return d->parameters;
 }
@@ -651,7 +690,7 @@ cv::Mat RecognitionDatabase::Private::preprocessingChain(const QImage& image)
 {
     try
     {
-        cv::Mat cvImage = recognizer()->prepareForRecognition(image);
+        cv::Mat cvImage = CurrentRecognizer::prepareForRecognition(image);
         //cvImage         = aligner()->align(cvImage);
         //TanTriggsPreprocessor preprocessor;
         //cvImage         = preprocessor.preprocess(cvImage);
@@ -669,14 +708,120 @@ cv::Mat RecognitionDatabase::Private::preprocessingChain(const QImage& image)
     }
 }
 
-QList<Identity> RecognitionDatabase::recognizeFaces(ImageListProvider* const images)
+cv::Mat RecognitionDatabase::Private::preprocessingChain(const cv::Mat& grayImage)
+{
+    try
+    {
+        return CurrentRecognizer::prepareForRecognition(grayImage);
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+        return cv::Mat();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+        return cv::Mat();
+    }
+}
+
+QList<Identity> RecognitionDatabase::recognizeFaces(const QImage& image, const QList<QRectF>& faces)
 {
     if (!d || !d->dbAvailable)
     {
         return QList<Identity>();
     }
 
-    QMutexLocker lock(&d->mutex);
+    cv::Mat grayImage;
+
+    try
+    {
+        // Once for all faces
+        grayImage = grayMatFromQImage(image);
+    }
+    catch (cv::Exception& e)
+    {
+        qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+    }
+    catch(...)
+    {
+        qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+    }
+
+    if (grayImage.empty())
+    {
+        QList<Identity> result;
+
+        for (int i = 0 ; i < faces.size() ; ++i)
+        {
+            result << Identity();
+        }
+
+        return result;
+    }
+
+    return recognizeFaces(grayImage, FaceDetector::toAbsoluteRects(faces, image.size()));
+}
+
+QList<Identity> RecognitionDatabase::recognizeFaces(const cv::Mat& grayImage, const QList<QRect>& faces)
+{
+    if (!d || !d->dbAvailable)
+    {
+        return QList<Identity>();
+    }
+
+    QList<Identity> result;
+    const cv::Rect imageRect(0, 0, grayImage.cols, grayImage.rows);
+
+    foreach (const QRect& face, faces)
+    {
+        int id = -1;
+
+        // A region of the image, without copying its pixels
+        const cv::Rect roi = cv::Rect(face.x(), face.y(), face.width(), face.height()) & imageRect;
+
+        if (roi.area() <= 0)
+        {
+            result << Identity();
+            continue;
+        }
+
+        const cv::Mat cvImage = d->preprocessingChain(grayImage(roi));
+        QReadLocker lock(&d->readWriteLock);
+
+        try
+        {
+            id = d->recognizer()->recognize(cvImage);
+        }
+        catch (cv::Exception& e)
+        {
+            qCCritical(LIBKFACE_LOG) << "cv::Exception:" << e.what();
+        }
+        catch(...)
+        {
+            qCCritical(LIBKFACE_LOG) << "Default exception from OpenCV";
+        }
+
+        if (id == -1)
+        {
+            result << Identity();
+        }
+        else
+        {
+            result << d->identityCache.value(id);
+        }
+    }
+
+    return result;
+}
+
+QList<Identity> RecognitionDatabase::recognizeFaces(ImageListProvider* const images)
+{
+    if (!d || !d->dbAvailable)
+    {
+        return QList<Identity>();
+    }
 
     QList<Identity> result;
 
@@ -684,9 +829,13 @@ QList<Identity> RecognitionDatabase::recognizeFaces(ImageListProvider* const ima
     {
         int id = -1;
 
+        // Only the recognition itself is done with the shared lock
+        const cv::Mat cvImage = d->preprocessingChain(images->image());
+        QReadLocker lock(&d->readWriteLock);
+
         try
         {
-            id = d->recognizer()->recognize(d->preprocessingChain(images->image()));
+            id = d->recognizer()->recognize(cvImage);
         }
         catch (cv::Exception& e)
         {
@@ -749,6 +898,7 @@ static void trainSingle(Recognizer* const r, const Identity& identity, TrainingD
 
 /// Training where the train method takes a list of identities and images,
 /// and updating per-identity is non-inferior to updating all at once.
+/// Recognitions continue meanwhile with the previous version of the model.
 template <class Recognizer>
 static void trainIdentityBatch(Recognizer* const r, const QList<Identity>& identitiesToBeTrained,
                                TrainingDataProvider* const data, const QString& trainingContext,
@@ -798,9 +948,16 @@ static void trainIdentityBatch(Recognizer* const r, const QList<Identity>& ident
     }
 }
 
-void RecognitionDatabase::Private::train(OpenCVLBPHFaceRecognizer* const r, const QList<Identity>& identitiesToBeTrained,
+void RecognitionDatabase::Private::train(const QList<Identity>& identitiesToBeTrained,
                                          TrainingDataProvider* const data, const QString& trainingContext)
 {
+    CurrentRecognizer* r = 0;
+
+    {
+        QReadLocker lock(&readWriteLock);
+        r = recognizer();
+    }
+
     trainIdentityBatch(r, identitiesToBeTrained, data, trainingContext, this);
 }
 
@@ -812,9 +969,7 @@ void RecognitionDatabase::train(const QList<Identity>& identitiesToBeTrained, Tr
             return;
     }
 
-    QMutexLocker lock(&d->mutex);
-
-    d->train(d->recognizer(), identitiesToBeTrained, data, trainingContext);
+    d->train(identitiesToBeTrained, data, trainingContext);
 }
 
 
@@ -837,20 +992,17 @@ void RecognitionDatabase::train(const Identity& identityToBeTrained, const QList
     delete data;
 }
 
-void RecognitionDatabase::Private::clear(OpenCVLBPHFaceRecognizer* const, const QList<int>& idsToClear, const QString& trainingContext)
+void RecognitionDatabase::Private::clear(const QList<int>& idsToClear, const QString& trainingContext)
 {
-    // force later reload
-    delete opencvlbph;
-    opencvlbph = 0;
+    CurrentRecognizer* r = 0;
 
-    if (idsToClear.isEmpty())
     {
-        DatabaseFaceAccess(db).db()->clearLBPHTraining(trainingContext);
-    }
-    else
-    {
-        DatabaseFaceAccess(db).db()->clearLBPHTraining(idsToClear, trainingContext);
+        QReadLocker lock(&readWriteLock);
+        r = recognizer();
     }
+
+    // The recognizer reloads the remaining training as a new version of its model
+    r->clearTraining(idsToClear, trainingContext);
 }
 
 void RecognitionDatabase::clearAllTraining(const QString& trainingContext)
@@ -860,8 +1012,7 @@ void RecognitionDatabase::clearAllTraining(const QString& trainingContext)
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
-    d->clear(d->recognizer(), QList<int>(), trainingContext);
+    d->clear(QList<int>(), trainingContext);
 }
 
 void RecognitionDatabase::clearTraining(const QList<Identity>& identitiesToClean, const QString& trainingContext)
@@ -871,15 +1022,14 @@ void RecognitionDatabase::clearTraining(const QList<Identity>& identitiesToClean
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
-    QList<int>   ids;
+    QList<int> ids;
 
     foreach (const Identity& id, identitiesToClean)
     {
         ids << id.id();
     }
 
-    d->clear(d->recognizer(), ids, trainingContext);
+    d->clear(ids, trainingContext);
 }
 
 void RecognitionDatabase::deleteIdentity(const Identity& identityToBeDeleted)
@@ -889,7 +1039,7 @@ void RecognitionDatabase::deleteIdentity(const Identity& identityToBeDeleted)
         return;
     }
 
-    QMutexLocker lock(&d->mutex);
+    QWriteLocker lock(&d->readWriteLock);
 
     DatabaseFaceAccess(d->db).db()->deleteIdentity(identityToBeDeleted.id());
     d->identityCache.remove(identityToBeDeleted.id());
@@ -36,6 +36,8 @@
 #include <QImage>
 #include <QList>
 #include <QMap>
+#include <QRect>
+#include <QRectF>
 #include <QVariant>
 
 // Local includes
@@ -44,6 +46,11 @@
 #include "identity.h"
 #include "dataproviders.h"
 
+namespace cv
+{
+class Mat;
+}
+
 namespace KFaceIface
 {
 
@@ -56,7 +63,11 @@ namespace KFaceIface
  * - deferred creation: The backend is created only when used first.
  * - only one instance per configuration path is created
  * - an instance of this class is thread-safe
- *   (this class is also reentrant, for different objects and paths)
+ *   (this class is also reentrant, for different objects and paths).
+ *   Recognitions and identity lookups run concurrently. Training and clearing
+ *   build a new version of the trained model, which replaces the old one when
+ *   complete: they do not block recognitions, which finish with the version they
+ *   started with. Changes to identities or parameters wait for running recognitions.
  */
 class LIBKFACE_EXPORT RecognitionDatabase
 {
@@ -144,6 +155,10 @@ public:
      * Available parameters:
      * "accuracy", synonymous: "threshold", range: 0-1, type: float
      * Determines recognition threshold, 0->accept very unsecure recognitions, 1-> be very sure about a recognition.
+     * "parallelScanThreshold", type: int, default: 1024
+     * Minimum number of trained samples from which the search for the nearest samples is split over several threads.
+     * "parallelScanThreads", type: int, default: 0
+     * Number of threads used for this search. 0 uses the OpenCV default, 1 disables the parallel search.
      */
     void        setParameter(const QString& parameter, const QVariant& value);
     void        setParameters(const QVariantMap& parameters);
@@ -167,6 +182,16 @@ public:
     QList<Identity> recognizeFaces(const QList<QImage>& images);
     Identity        recognizeFace(const QImage& image);
 
+    /**
+     * Performs recognition of many faces in one image, like a group photo.
+     * The faces are given in relative coordinates, as returned by FaceDetector.
+     * For each face, in 1-to-1 mapping, a recognized identity or the null identity is returned.
+     *
+     * The image is converted to gray once, and each face is read as a region of it,
+     * instead of cutting out and converting each face separately.
+     */
+    QList<Identity> recognizeFaces(const QImage& image, const QList<QRectF>& faces);
+
     /**
      * Gives a hint about the complexity of training for the current backend.
      */
@@ -227,9 +252,16 @@ private:
 
     explicit RecognitionDatabase(QExplicitlySharedDataPointer<Private> d);
 
+    /**
+     * Recognizes the faces in the regions, in absolute coordinates, of an 8-bit gray image.
+     * The regions are read in place, grayImage is not modified.
+     */
+    QList<Identity> recognizeFaces(const cv::Mat& grayImage, const QList<QRect>& faces);
+
     QExplicitlySharedDataPointer<Private> d;
 
     friend class RecognitionDatabaseStaticPriv;
+    friend class FacePipeline;
 };
 
 /**
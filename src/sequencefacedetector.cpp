@@ -0,0 +1,277 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Face detection in a sequence of video frames, tracking found faces.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#include "sequencefacedetector.h"
+
+namespace KFaceIface
+{
+
+namespace
+{
+
+/**
+ * Intersection over union of two relative rectangles.
+ */
+qreal overlap(const QRectF& r1, const QRectF& r2)
+{
+    const QRectF intersection = r1.intersected(r2);
+
+    if (intersection.isEmpty())
+    {
+        return 0;
+    }
+
+    const qreal intersectionArea = intersection.width() * intersection.height();
+
+    return intersectionArea / (r1.width() * r1.height() + r2.width() * r2.height() - intersectionArea);
+}
+
+} // namespace
+
+class SequenceFaceDetector::Private
+{
+public:
+
+    /// A face followed through the frames
+    class Track
+    {
+    public:
+
+        Track()
+            : id(0),
+              missedFrames(0)
+        {
+        }
+
+    public:
+
+        int    id;
+        QRectF rect;
+        int    missedFrames;
+    };
+
+public:
+
+    explicit Private(const FaceDetector& detector)
+        : detector(detector),
+          keyframeInterval(10),
+          verificationInterval(5),
+          maxMissedFrames(2),
+          frame(0),
+          nextTrackId(1)
+    {
+    }
+
+    /**
+     * Assigns the faces found to the tracks, each to the free track it overlaps most.
+     * Faces overlapping no track start a new one if newTracks is true.
+     * Returns the tracks of the faces, in the order of faces.
+     */
+    QList<int> assign(const QList<QRectF>& faces, bool newTracks)
+    {
+        // Minimum overlap with the previous position: the scanned region is padded by a quarter of the face
+        const qreal minOverlap = 0.2;
+        QList<bool> matched;
+        QList<int>  assigned;
+
+        for (int t = 0 ; t < tracks.size() ; ++t)
+        {
+            matched << false;
+        }
+
+        foreach (const QRectF& face, faces)
+        {
+            int   best        = -1;
+            qreal bestOverlap = minOverlap;
+
+            for (int t = 0 ; t < tracks.size() ; ++t)
+            {
+                const qreal o = overlap(tracks.at(t).rect, face);
+
+                if (!matched.at(t) && o >= bestOverlap)
+                {
+                    best        = t;
+                    bestOverlap = o;
+                }
+            }
+
+            if (best == -1)
+            {
+                if (!newTracks)
+                {
+                    assigned << -1;
+                    continue;
+                }
+
+                Track track;
+                track.id = nextTrackId++;
+                tracks  << track;
+                matched << false;
+                best     = tracks.size() - 1;
+            }
+
+            tracks[best].rect         = face;
+            tracks[best].missedFrames = 0;
+            matched[best]             = true;
+            assigned << best;
+        }
+
+        // Tracks not seen in this frame
+        for (int t = tracks.size() - 1 ; t >= 0 ; --t)
+        {
+            if (matched.at(t))
+            {
+                continue;
+            }
+
+            if (++tracks[t].missedFrames > maxMissedFrames)
+            {
+                tracks.removeAt(t);
+
+                for (int i = 0 ; i < assigned.size() ; ++i)
+                {
+                    if (assigned.at(i) > t)
+                    {
+                        assigned[i]--;
+                    }
+                }
+            }
+        }
+
+        return assigned;
+    }
+
+public:
+
+    FaceDetector detector;
+
+    int          keyframeInterval;
+    int          verificationInterval;
+    int          maxMissedFrames;
+
+    int          frame;
+    int          nextTrackId;
+    QList<Track> tracks;
+    QList<int>   lastTrackIds;
+};
+
+SequenceFaceDetector::SequenceFaceDetector(const FaceDetector& detector)
+    : d(new Private(detector))
+{
+}
+
+SequenceFaceDetector::~SequenceFaceDetector()
+{
+    delete d;
+}
+
+QList<QRectF> SequenceFaceDetector::detectFaces(const QImage& frame, bool keyframe)
+{
+    const bool isKeyframe = keyframe || (d->frame % d->keyframeInterval) == 0;
+    QList<QRectF> faces;
+
+    if (isKeyframe)
+    {
+        faces = d->detector.detectFaces(frame);
+    }
+    else if (!d->tracks.isEmpty())
+    {
+        // Only the regions around the tracked faces, verified from time to time
+        const bool verify = (d->frame % d->verificationInterval) == 0;
+        QList<QRectF> regions;
+
+        foreach (const Private::Track& track, d->tracks)
+        {
+            regions << track.rect;
+        }
+
+        faces = d->detector.detectFaces(frame, regions, QSize(), verify);
+    }
+
+    const QList<int> assigned = d->assign(faces, isKeyframe);
+    QList<QRectF> result;
+
+    d->lastTrackIds.clear();
+
+    for (int i = 0 ; i < faces.size() ; ++i)
+    {
+        if (assigned.at(i) == -1)
+        {
+            continue;
+        }
+
+        result          << faces.at(i);
+        d->lastTrackIds << d->tracks.at(assigned.at(i)).id;
+    }
+
+    d->frame++;
+
+    return result;
+}
+
+QList<int> SequenceFaceDetector::trackIds() const
+{
+    return d->lastTrackIds;
+}
+
+void SequenceFaceDetector::reset()
+{
+    d->tracks.clear();
+    d->lastTrackIds.clear();
+    d->frame = 0;
+}
+
+void SequenceFaceDetector::setKeyframeInterval(int frames)
+{
+    d->keyframeInterval = qMax(1, frames);
+}
+
+int SequenceFaceDetector::keyframeInterval() const
+{
+    return d->keyframeInterval;
+}
+
+void SequenceFaceDetector::setVerificationInterval(int frames)
+{
+    d->verificationInterval = qMax(1, frames);
+}
+
+int SequenceFaceDetector::verificationInterval() const
+{
+    return d->verificationInterval;
+}
+
+void SequenceFaceDetector::setMaxMissedFrames(int frames)
+{
+    d->maxMissedFrames = qMax(0, frames);
+}
+
+int SequenceFaceDetector::maxMissedFrames() const
+{
+    return d->maxMissedFrames;
+}
+
+} // namespace KFaceIface
@@ -0,0 +1,101 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Face detection in a sequence of video frames, tracking found faces.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+#ifndef KFACE_SEQUENCEFACEDETECTOR_H
+#define KFACE_SEQUENCEFACEDETECTOR_H
+
+// Qt includes
+
+#include <QImage>
+#include <QList>
+#include <QRectF>
+
+// Local includes
+
+#include "libkface_export.h"
+#include "facedetector.h"
+
+namespace KFaceIface
+{
+
+class LIBKFACE_EXPORT SequenceFaceDetector
+{
+
+public:
+
+    /**
+     * Detects faces in the consecutive frames of a video, using the backend and parameters of detector.
+     *
+     * Faces move little between frames: the whole frame is only scanned on keyframes, every
+     * keyframeInterval() frames. In the frames in between, each face found before is tracked by a
+     * scan of the region around its previous position. Tracked faces are checked by the verifying
+     * cascades every verificationInterval() frames, and dropped when not found again in
+     * maxMissedFrames() consecutive frames.
+     *
+     * An object keeps the state of one sequence and must be used from one thread at a time.
+     */
+    explicit SequenceFaceDetector(const FaceDetector& detector = FaceDetector());
+    ~SequenceFaceDetector();
+
+    /**
+     * Returns the faces in frame, the next frame of the sequence, in relative coordinates.
+     * Pass keyframe if the whole frame must be scanned, for example after a scene cut.
+     */
+    QList<QRectF> detectFaces(const QImage& frame, bool keyframe = false);
+
+    /**
+     * Returns the identifiers of the tracks of the faces returned by the last detectFaces(),
+     * in the same order. A face keeps its identifier while it is tracked.
+     */
+    QList<int> trackIds() const;
+
+    /// Forgets all tracked faces. The next frame is a keyframe.
+    void reset();
+
+    /// Default: 10
+    void setKeyframeInterval(int frames);
+    int  keyframeInterval() const;
+
+    /// Default: 5
+    void setVerificationInterval(int frames);
+    int  verificationInterval() const;
+
+    /// Default: 2
+    void setMaxMissedFrames(int frames);
+    int  maxMissedFrames() const;
+
+private:
+
+    SequenceFaceDetector(const SequenceFaceDetector&);
+    SequenceFaceDetector& operator=(const SequenceFaceDetector&);
+
+    class Private;
+    Private* const d;
+};
+
+} // namespace KFaceIface
+
+#endif // KFACE_SEQUENCEFACEDETECTOR_H
@@ -0,0 +1,132 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Micro-benchmark of the LBPH chi-square distance kernel
+ *         against cv::compareHist(CV_COMP_CHISQR).
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// OpenCV includes
+
+#include "libopencv.h"
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+
+// Local includes
+
+#include "src/recognition-opencv-lbph/histogramdistance.h"
+
+using namespace KFaceIface;
+
+// --------------------------------------------------------------------------------------------------
+
+/// A normalized LBPH spatial histogram (8x8 cells of 256 bins), as computed by LBPHFaceRecognizer.
+cv::Mat randomHistogram(cv::RNG& rng)
+{
+    const int cells    = 8 * 8;
+    const int patterns = 256;
+    const int samples  = 30 * 30;
+    cv::Mat histogram  = cv::Mat::zeros(cells, patterns, CV_32FC1);
+
+    for (int cell = 0 ; cell < cells ; cell++)
+    {
+        float* const row = histogram.ptr<float>(cell);
+
+        for (int i = 0 ; i < samples ; i++)
+        {
+            // LBP codes are far from uniform, favor a subset of the patterns
+            row[rng.uniform(0, patterns) & rng.uniform(0, patterns)] += 1.0f / samples;
+        }
+    }
+
+    return histogram.reshape(1, 1);
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int gallerySize = 10000;
+
+    if (argc > 1)
+    {
+        gallerySize = QString::fromLocal8Bit(argv[1]).toInt();
+    }
+
+    if (gallerySize <= 0)
+    {
+        qDebug() << "Bad Arguments!!!\nUsage: " << argv[0] << " [number of gallery histograms]";
+        return 0;
+    }
+
+    cv::RNG rng(0x4b46414345);
+    std::vector<cv::Mat> gallery;
+    gallery.reserve(gallerySize);
+
+    for (int i = 0 ; i < gallerySize ; i++)
+    {
+        gallery.push_back(randomHistogram(rng));
+    }
+
+    const cv::Mat query = randomHistogram(rng);
+    const int length    = (int)query.total();
+
+    QElapsedTimer timer;
+    double referenceSum = 0;
+    double kernelSum    = 0;
+    double maxRelError  = 0;
+
+    timer.start();
+
+    for (int i = 0 ; i < gallerySize ; i++)
+    {
+        referenceSum += cv::compareHist(gallery[i], query, CV_COMP_CHISQR);
+    }
+
+    const qint64 referenceTime = timer.nsecsElapsed();
+    timer.restart();
+
+    for (int i = 0 ; i < gallerySize ; i++)
+    {
+        kernelSum += chiSquareDistance(gallery[i].ptr<float>(), query.ptr<float>(), length);
+    }
+
+    const qint64 kernelTime = timer.nsecsElapsed();
+
+    for (int i = 0 ; i < gallerySize ; i++)
+    {
+        const double reference = cv::compareHist(gallery[i], query, CV_COMP_CHISQR);
+        const double distance  = chiSquareDistance(gallery[i].ptr<float>(), query.ptr<float>(), length);
+        maxRelError            = qMax(maxRelError, qAbs(distance - reference) / qMax(reference, DBL_EPSILON));
+    }
+
+    qDebug() << "Gallery of" << gallerySize << "histograms with" << length << "bins";
+    qDebug() << "cv::compareHist        :" << referenceTime / 1000000.0 << "ms, sum" << referenceSum;
+    qDebug() << "chiSquareDistance" << chiSquareDistanceImplementation() << ":"
+             << kernelTime / 1000000.0 << "ms, sum" << kernelSum;
+    qDebug() << "Speedup:" << double(referenceTime) / qMax(kernelTime, qint64(1))
+             << "max. relative error:" << maxRelError;
+
+    return 0;
+}
@@ -48,6 +48,11 @@ void detectFaces(const QString& file)
     QList<QRectF> faces = detector.detectFaces(img);
     qDebug() << "Detected";
 
+    // Decoded at the detection resolution, the faces found should be about the same
+    const QList<QRectF> fileFaces = detector.detectFaces(file);
+    qDebug() << "Detected from file:" << fileFaces.size() << "faces"
+             << (fileFaces.size() == faces.size() ? "" : "MISMATCH");
+
     if (faces.isEmpty())
     {
         qDebug() << "No faces found";
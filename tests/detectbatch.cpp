@@ -0,0 +1,81 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Compares batch face detection with image by image detection.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QDebug>
+
+// Local includes
+
+#include "src/facedetector.h"
+
+using namespace KFaceIface;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        qDebug() << "Bad Arguments!!!\nUsage: " << argv[0] << " <image1> <image2> ...";
+        return 0;
+    }
+
+    QCoreApplication app(argc, argv);
+
+    QList<QImage> images;
+
+    for (int i = 1 ; i < argc ; i++)
+    {
+        images << QImage(QString::fromLocal8Bit(argv[i]));
+    }
+
+    FaceDetector detector;
+    QElapsedTimer timer;
+
+    // Loads the cascades
+    detector.detectFaces(images.first());
+
+    timer.start();
+    QList<QList<QRectF> > serial;
+
+    foreach (const QImage& image, images)
+    {
+        serial << detector.detectFaces(image);
+    }
+
+    const qint64 serialTime = timer.restart();
+    QList<QList<QRectF> > batch = detector.detectFaces(images);
+    const qint64 batchTime      = timer.elapsed();
+
+    for (int i = 0 ; i < images.size() ; i++)
+    {
+        qDebug() << argv[i + 1] << ":" << batch[i].size() << "faces" << (batch[i] == serial[i] ? "" : "MISMATCH");
+    }
+
+    qDebug() << "Image by image:" << serialTime << "ms, batch:" << batchTime << "ms";
+
+    return 0;
+}
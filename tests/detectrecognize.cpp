@@ -0,0 +1,121 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Compares the face pipeline with separate detection and recognition.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QDebug>
+
+// Local includes
+
+#include "src/facedetector.h"
+#include "src/facepipeline.h"
+#include "src/recognitiondatabase.h"
+
+using namespace KFaceIface;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        qDebug() << "Bad Arguments!!!\nUsage: " << argv[0] << " <image1> <image2> ...";
+        return 0;
+    }
+
+    QCoreApplication app(argc, argv);
+
+    QList<QImage> images;
+
+    for (int i = 1 ; i < argc ; i++)
+    {
+        images << QImage(QString::fromLocal8Bit(argv[i]));
+    }
+
+    FaceDetector detector;
+    RecognitionDatabase db = RecognitionDatabase::addDatabase(QDir::currentPath());
+    FacePipeline pipeline(detector, db);
+    QElapsedTimer timer;
+
+    // Loads the cascades
+    detector.detectFaces(images.first());
+
+    timer.start();
+    QList<QList<Identity> > separate;
+
+    foreach (const QImage& image, images)
+    {
+        QList<QImage> faces;
+
+        foreach (const QRectF& rect, detector.detectFaces(image))
+        {
+            faces << image.copy(FaceDetector::toAbsoluteRect(rect, image.size()));
+        }
+
+        separate << db.recognizeFaces(faces);
+    }
+
+    const qint64 separateTime               = timer.restart();
+    QList<QList<RecognizedFace> > pipelined = pipeline.process(images);
+    const qint64 pipelineTime               = timer.elapsed();
+
+    int mismatches = 0;
+
+    for (int i = 0 ; i < images.size() ; i++)
+    {
+        const bool sameCount = (pipelined[i].size() == separate[i].size());
+
+        qDebug() << argv[i + 1] << ":" << pipelined[i].size() << "faces"
+                 << (sameCount ? "" : "MISMATCH");
+
+        if (!sameCount)
+        {
+            mismatches++;
+        }
+
+        for (int j = 0 ; j < pipelined[i].size() ; j++)
+        {
+            const RecognizedFace& face = pipelined[i].at(j);
+
+            // The recognition on the region of the gray image must give the identity of the cropped face
+            const bool sameIdentity    = sameCount && (face.identity.id() == separate[i].at(j).id());
+
+            qDebug() << "   " << face.rect << face.identity.attribute(QString::fromLatin1("name"))
+                     << (sameIdentity ? "" : "IDENTITY MISMATCH");
+
+            if (sameCount && !sameIdentity)
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    qDebug() << mismatches << "mismatches";
+
+    qDebug() << "Separate detection and recognition:" << separateTime << "ms, pipeline:" << pipelineTime << "ms";
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/** ===========================================================
+ * @file
+ *
+ * This file is a part of KDE project
+ *
+ *
+ * @date   2026-10-16
+ * @brief  Compares face detection in a frame sequence with frame by frame detection.
+ *
+ * @author Copyright (C) 2026 by the libkface developers
+ *
+ * This program is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation;
+ * either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * ============================================================ */
+
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QDebug>
+
+// Local includes
+
+#include "src/facedetector.h"
+#include "src/sequencefacedetector.h"
+
+using namespace KFaceIface;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        qDebug() << "Bad Arguments!!!\nUsage: " << argv[0] << " <frame1> <frame2> ...";
+        return 0;
+    }
+
+    QCoreApplication app(argc, argv);
+
+    QList<QImage> frames;
+
+    for (int i = 1 ; i < argc ; i++)
+    {
+        frames << QImage(QString::fromLocal8Bit(argv[i]));
+    }
+
+    FaceDetector detector;
+    SequenceFaceDetector sequence(detector);
+    QElapsedTimer timer;
+
+    // Loads the cascades
+    detector.detectFaces(frames.first());
+
+    timer.start();
+    QList<QList<QRectF> > single;
+
+    foreach (const QImage& frame, frames)
+    {
+        single << detector.detectFaces(frame);
+    }
+
+    const qint64 singleTime = timer.restart();
+    QList<QList<QRectF> > tracked;
+    QList<QList<int> >    trackIds;
+
+    foreach (const QImage& frame, frames)
+    {
+        tracked  << sequence.detectFaces(frame);
+        trackIds << sequence.trackIds();
+    }
+
+    const qint64 sequenceTime = timer.elapsed();
+
+    for (int i = 0 ; i < frames.size() ; i++)
+    {
+        qDebug() << argv[i + 1] << ":" << single[i].size() << "faces frame by frame,"
+                 << tracked[i].size() << "in sequence, tracks" << trackIds[i];
+    }
+
+    qDebug() << "Frame by frame:" << singleTime << "ms, sequence:" << sequenceTime << "ms";
+
+    return 0;
+}